@@ -0,0 +1,72 @@
+// Storage footprint under churn with row and slotted blocks:
+// every round removes a random key from the BPTree and adds as many new records as it held.
+// Build from the repository root:
+//   g++ -O2 -pthread bench/bench_churn.cpp bptree.cpp bufferpool.cpp epoch.cpp nodearena.cpp nodesearch.cpp posting.cpp storage.cpp mappedfile.cpp -o bench_churn
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../bptree.h"
+#include "../storage.h"
+
+using namespace std;
+
+int main() {
+    int numRecords = 1000000;
+    int maxVotes = 100000;
+    int numRounds = 5;
+    int removesPerRound = 20000;
+    int blockSizes[] = {200, 500};
+    BlockFormat formats[] = {ROW_BLOCKS, SLOTTED_BLOCKS};
+    const char *formatNames[] = {"row", "slotted"};
+
+    cout << "block size\tformat\tround\trecords\tblocks used\tchurn ops/s" << endl;
+    for (int blockSize : blockSizes) {
+        for (int f = 0; f < 2; f++) {
+            Storage storage(100000000, blockSize, formats[f]);
+            mt19937 rng(42);
+            auto addRecord = [&](int numVotes) {
+                RID rid = storage.addRecord(sizeof(Record));
+                Record *record = storage.getRecord(rid);
+                record->averageRating = (rng() % 91 + 10) / 10.0f;
+                record->numVotes = numVotes;
+                return rid;
+            };
+
+            vector<RID> dataEntries;
+            for (int i = 0; i < numRecords; i++) {
+                dataEntries.push_back(addRecord(rng() % maxVotes));
+            }
+            BPTree bptree(&storage);
+            bptree.bulkLoad(dataEntries, 1.0);
+            cout << blockSize << "\t\t" << formatNames[f] << "\t0\t" << storage.getNumRecords() << "\t"
+                 << storage.getBlocksUsed() << endl;
+
+            for (int round = 1; round <= numRounds; round++) {
+                long long numOps = 0;
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                for (int i = 0; i < removesPerRound; i++) {
+                    int key = rng() % maxVotes;
+                    int numRemoved = bptree.lookup(key).size();
+                    if (numRemoved == 0) {
+                        continue;
+                    }
+                    bptree.remove(key);
+                    for (int j = 0; j < numRemoved; j++) {
+                        Key newKey;
+                        newKey.key_value = rng() % maxVotes;
+                        newKey.address.push_back(addRecord(newKey.key_value));
+                        bptree.insert(newKey);
+                    }
+                    numOps += 1 + numRemoved;
+                }
+                double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                cout << blockSize << "\t\t" << formatNames[f] << "\t" << round << "\t" << storage.getNumRecords() << "\t"
+                     << storage.getBlocksUsed() << "\t\t" << (long long)(numOps / seconds) << endl;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+// Data blocks accessed by numVotes queries with records in load order and clustered in numVotes order,
+// read through a 64-frame buffer pool over the block file. Inserts after clustering land in the
+// last blocks, a second BPTree::cluster reorganizes them.
+// Build from the repository root:
+//   g++ -O2 -pthread bench/bench_cluster.cpp bptree.cpp bufferpool.cpp epoch.cpp nodearena.cpp nodesearch.cpp posting.cpp storage.cpp mappedfile.cpp -o bench_cluster
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../bptree.h"
+#include "../bufferpool.h"
+#include "../storage.h"
+
+using namespace std;
+
+int main() {
+    int numRecords = 1000000;
+    int numInserts = 100000;
+    int blockSizes[] = {200, 500};
+    int ranges[][2] = {{500, 500}, {30000, 40000}, {100, 1000}, {5, 100000}};
+
+    cout << "block size\tlayout\t\trange\t\trecords\tindex nodes\tdata blocks\tphysical reads\tquery us" << endl;
+    for (int blockSize : blockSizes) {
+        string filename = "bench_cluster_" + to_string(blockSize) + "B.db";
+        remove(filename.c_str());
+        {
+            // numVotes skewed towards small values like the IMDb data
+            Storage storage(filename, 0, blockSize);
+            vector<RID> dataEntries;
+            mt19937 rng(42);
+            exponential_distribution<double> votes(1.0 / 10000);
+            auto addRecord = [&]() {
+                RID rid = storage.addRecord(sizeof(Record));
+                Record *record = storage.getRecord(rid);
+                snprintf(record->tconst, sizeof(record->tconst), "tt%07d", (int)storage.getNumRecords());
+                record->averageRating = (rng() % 91 + 10) / 10.0f;
+                record->numVotes = 5 + (int)votes(rng);
+                return rid;
+            };
+            for (int i = 0; i < numRecords; i++) {
+                dataEntries.push_back(addRecord());
+            }
+            BPTree bptree(&storage);
+            bptree.bulkLoad(dataEntries, 1.0);
+
+            auto report = [&](const char *layout) {
+                storage.flush();
+                BufferPool bufferPool(filename, blockSize, 64);
+                for (auto &range : ranges) {
+                    bufferPool.resetStats();
+                    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                    Aggregate result = bptree.aggregate(range[0], range[1], AVERAGE_RATING, &bufferPool);
+                    double us = chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e6;
+                    cout << blockSize << "\t\t" << layout << "\t" << range[0] << "-" << range[1] << "\t"
+                         << (range[1] - range[0] < 1000 ? "\t" : "") << result.count << "\t" << result.numIndexNodes
+                         << "\t\t" << result.numDataBlocks << "\t\t" << bufferPool.getPhysicalReads() << "\t\t"
+                         << (long long)us << endl;
+                }
+            };
+
+            report("load order");
+
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            bptree.cluster();
+            double clusterSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            report("clustered");
+
+            // new records are appended after the clustered blocks
+            for (int i = 0; i < numInserts; i++) {
+                Key newKey;
+                newKey.address.push_back(addRecord());
+                newKey.key_value = storage.getRecord(newKey.address[0])->numVotes;
+                bptree.insert(newKey);
+            }
+            report("+10% inserts");
+
+            start = chrono::steady_clock::now();
+            bptree.cluster();
+            double reclusterSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            report("reclustered");
+            cout << blockSize << "\t\tcluster s " << clusterSeconds << ", recluster s " << reclusterSeconds << endl;
+        }
+        remove(filename.c_str());
+    }
+    return 0;
+}
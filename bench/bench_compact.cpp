@@ -0,0 +1,79 @@
+// Blocks used and data blocks accessed by numVotes range queries with full 20-byte records and compact
+// 10-byte records, with records in load order and clustered in numVotes order, and a full-table BlockScan.
+// Build from the repository root:
+//   g++ -O2 -pthread bench/bench_compact.cpp blockscan.cpp bptree.cpp bufferpool.cpp epoch.cpp nodearena.cpp nodesearch.cpp posting.cpp storage.cpp mappedfile.cpp -o bench_compact
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../blockscan.h"
+#include "../bptree.h"
+#include "../storage.h"
+
+using namespace std;
+
+// average seconds of numRuns calls of fn
+static double timeRuns(int numRuns, const function<void()> &fn) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int run = 0; run < numRuns; run++) {
+        fn();
+    }
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count() / numRuns;
+}
+
+int main() {
+    int numRecords = 1000000;
+    int numRuns = 5;
+    int blockSizes[] = {200, 500};
+    RecordEncoding encodings[] = {FULL_RECORDS, COMPACT_RECORDS};
+    int ranges[][2] = {{500, 500}, {30000, 40000}, {100, 1000}};
+
+    cout << "block size\tencoding\tlayout\t\tblocks\trange\t\trecords\tdata blocks\tquery us\tscan ms" << endl;
+    for (int blockSize : blockSizes) {
+        for (RecordEncoding encoding : encodings) {
+            // numVotes skewed towards small values and ratings around 6.5 like the IMDb data
+            Storage storage(0, blockSize, ROW_BLOCKS, encoding);
+            vector<RID> dataEntries;
+            mt19937 rng(42);
+            exponential_distribution<double> votes(1.0 / 10000);
+            normal_distribution<double> rating(6.5, 1.2);
+            for (int i = 0; i < numRecords; i++) {
+                Record record;
+                snprintf(record.tconst, sizeof(record.tconst), "tt%07d", i % 10000000);
+                record.averageRating = round(min(10.0, max(1.0, rating(rng))) * 10) / 10;
+                record.numVotes = 5 + (int)votes(rng);
+                RID rid = storage.addRecord(sizeof(Record));
+                storage.writeRecord(rid, record);
+                dataEntries.push_back(rid);
+            }
+            BPTree bptree(&storage);
+            bptree.bulkLoad(dataEntries, 1.0);
+            BlockScan blockScan(&storage, false);
+
+            for (int layout = 0; layout < 2; layout++) {
+                if (layout == 1) {
+                    bptree.cluster();
+                }
+                ScanPredicate highRating;
+                highRating.minRating = 8.0;
+                double scanSeconds = timeRuns(numRuns, [&]() { blockScan.aggregate(highRating, NUM_VOTES); });
+
+                for (auto &range : ranges) {
+                    Aggregate result;
+                    double seconds = timeRuns(numRuns, [&]() { result = bptree.aggregate(range[0], range[1], AVERAGE_RATING); });
+                    cout << blockSize << "\t\t" << (encoding == COMPACT_RECORDS ? "compact" : "full") << "\t\t"
+                         << (layout == 0 ? "load order" : "clustered") << "\t" << storage.getBlocksUsed() << "\t"
+                         << range[0] << "-" << range[1] << "\t" << (range[1] - range[0] < 1000 ? "\t" : "") << result.count
+                         << "\t" << result.numDataBlocks << "\t\t" << (long long)(seconds * 1e6) << "\t\t" << scanSeconds * 1e3
+                         << endl;
+                }
+            }
+        }
+    }
+    return 0;
+}
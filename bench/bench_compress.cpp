@@ -0,0 +1,77 @@
+// Compression ratio and full-table BlockScan throughput of COMPRESSED_BLOCKS storage against row blocks,
+// compressed in file order, where tconst is sequential, and clustered in numVotes order.
+// Build from the repository root:
+//   g++ -O2 -pthread bench/bench_compress.cpp blockscan.cpp bptree.cpp bufferpool.cpp epoch.cpp nodearena.cpp nodesearch.cpp posting.cpp storage.cpp mappedfile.cpp -o bench_compress
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../blockscan.h"
+#include "../bptree.h"
+#include "../storage.h"
+
+using namespace std;
+
+// average seconds of numRuns calls of fn
+static double timeRuns(int numRuns, const function<void()> &fn) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int run = 0; run < numRuns; run++) {
+        fn();
+    }
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count() / numRuns;
+}
+
+int main() {
+    int numRecords = 1000000;
+    int numRuns = 5;
+    int blockSizes[] = {200, 500, 4096};
+
+    cout << "block size\tlayout\t\tblocks\tMB\trecords/block\tratio\tscan ms\tMrecords/s\tGB/s read" << endl;
+    for (int blockSize : blockSizes) {
+        for (int layout = 0; layout < 3; layout++) {
+            // numVotes skewed towards small values and ratings around 6.5 like the IMDb data, tconst in file order
+            Storage storage(0, blockSize, layout == 0 ? ROW_BLOCKS : COMPRESSED_BLOCKS);
+            vector<RID> dataEntries;
+            mt19937 rng(42);
+            exponential_distribution<double> votes(1.0 / 10000);
+            normal_distribution<double> rating(6.5, 1.2);
+            for (int i = 0; i < numRecords; i++) {
+                Record record;
+                snprintf(record.tconst, sizeof(record.tconst), "tt%07d", (i + 1) % 10000000);
+                record.averageRating = round(min(10.0, max(1.0, rating(rng))) * 10) / 10;
+                record.numVotes = 5 + (int)votes(rng);
+                RID rid = storage.addRecord(sizeof(Record));
+                storage.writeRecord(rid, record);
+                dataEntries.push_back(rid);
+            }
+            BPTree bptree(&storage);
+            bptree.bulkLoad(dataEntries, 1.0);
+            if (layout == 1) {
+                bptree.compress();
+            } else if (layout == 2) {
+                bptree.cluster();
+            }
+
+            // compression ratio against the blocks the records take in the row format
+            long long rowBytes = (long long)(numRecords + blockSize / sizeof(Record) - 1) / (blockSize / sizeof(Record)) * blockSize;
+            long long bytes = storage.getStorageSizeAllocated();
+            BlockScan blockScan(&storage, false);
+            ScanPredicate highRating;
+            highRating.minRating = 8.0;
+            Aggregate scanned;
+            double seconds = timeRuns(numRuns, [&]() { scanned = blockScan.aggregate(highRating, NUM_VOTES); });
+
+            const char *layouts[] = {"row\t", "compressed", "clustered"};
+            cout << blockSize << "\t\t" << layouts[layout] << "\t" << storage.getBlocksUsed() << "\t" << bytes / 1e6 << "\t"
+                 << (double)numRecords / storage.getBlocksUsed() << "\t\t" << (double)rowBytes / bytes << "\t"
+                 << seconds * 1e3 << "\t" << numRecords / seconds / 1e6 << "\t\t" << bytes / seconds / 1e9 << "\t("
+                 << scanned.count << ")" << endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,101 @@
+// Throughput of a concurrent BPTree under a mixed workload as threads are added:
+// 80% lookups, 10% range aggregates over 100 keys, 5% inserts and 5% removes.
+// Build from the repository root:
+//   g++ -O2 -pthread bench/bench_concurrent.cpp bptree.cpp bufferpool.cpp epoch.cpp nodearena.cpp nodesearch.cpp posting.cpp storage.cpp mappedfile.cpp -o bench_concurrent
+// An optional argument sets the largest thread count, all hardware threads by default.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "../bptree.h"
+#include "../parallel.h"
+#include "../storage.h"
+
+using namespace std;
+
+int main(int argc, char **argv) {
+    int numRecords = 1000000;
+    int maxVotes = 100000;
+    int blockSizes[] = {200, 500};
+    int maxThreads = (argc > 1) ? atoi(argv[1]) : getNumThreads();
+    double seconds = 1.0;
+
+    vector<int> threadCounts;
+    for (int t = 1; t < maxThreads; t *= 2) {
+        threadCounts.push_back(t);
+    }
+    threadCounts.push_back(maxThreads);
+
+    cout << "block size\tthreads\tops/s\t\tlookups/s\tscans/s\t\twrites/s" << endl;
+    for (int blockSize : blockSizes) {
+        Storage storage(100000000, blockSize);
+        vector<RID> dataEntries;
+        mt19937 rng(42);
+        for (int i = 0; i < numRecords; i++) {
+            RID rid = storage.addRecord(sizeof(Record));
+            Record *record = storage.getRecord(rid);
+            record->averageRating = (rng() % 91 + 10) / 10.0f;
+            record->numVotes = rng() % maxVotes;
+            dataEntries.push_back(rid);
+        }
+
+        for (int numThreads : threadCounts) {
+            BPTree bptree(&storage, false, true);
+            bptree.bulkLoad(dataEntries, 1.0);
+
+            atomic<bool> stop(false);
+            atomic<long long> numLookups(0), numScans(0), numWrites(0);
+            vector<thread> workers;
+            for (int t = 0; t < numThreads; t++) {
+                workers.push_back(thread([&, t]() {
+                    mt19937 threadRng(t + 1);
+                    long long lookups = 0, scans = 0, writes = 0;
+                    while (!stop.load(memory_order_relaxed)) {
+                        int op = threadRng() % 100;
+                        RID rid = dataEntries[threadRng() % numRecords];
+                        Record *record = storage.getRecord(rid);
+                        if (op < 80) {
+                            bptree.lookup(record->numVotes);
+                            lookups++;
+                        } else if (op < 90) {
+                            bptree.aggregate(record->numVotes, record->numVotes + 100, AVERAGE_RATING);
+                            scans++;
+                        } else if (op < 95) {
+                            Key newKey;
+                            newKey.key_value = record->numVotes;
+                            newKey.address.push_back(rid);
+                            bptree.insert(newKey);
+                            writes++;
+                        } else {
+                            try {
+                                bptree.remove(record->numVotes);
+                            } catch (const logic_error &e) {
+                            }
+                            writes++;
+                        }
+                    }
+                    numLookups += lookups;
+                    numScans += scans;
+                    numWrites += writes;
+                }));
+            }
+            this_thread::sleep_for(chrono::duration<double>(seconds));
+            stop = true;
+            for (thread &worker : workers) {
+                worker.join();
+            }
+
+            long long numOps = numLookups + numScans + numWrites;
+            cout << blockSize << "\t\t" << numThreads << "\t" << (long long)(numOps / seconds) << "\t\t"
+                 << (long long)(numLookups / seconds) << "\t\t" << (long long)(numScans / seconds) << "\t\t"
+                 << (long long)(numWrites / seconds) << endl;
+        }
+    }
+    return 0;
+}
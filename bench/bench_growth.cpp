@@ -0,0 +1,59 @@
+// Storage growing extent by extent with no capacity given up front:
+// loads ten times the IMDb row count, then reads every record in block order and 10M records at random RIDs.
+// Build from the repository root, add -DSTORAGE_HUGE_PAGES=0 to compare without huge pages:
+//   g++ -O2 -pthread bench/bench_growth.cpp storage.cpp mappedfile.cpp -o bench_growth
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../storage.h"
+
+using namespace std;
+
+static double getSeconds(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+    int numRecords = 10700000;
+    int numLookups = 10000000;
+    int blockSizes[] = {200, 500};
+
+    cout << "huge pages " << STORAGE_HUGE_PAGES << endl;
+    cout << "block size\trecords\tblocks used\tMB allocated\tload s\tsweep s\trandom reads/s" << endl;
+    for (int blockSize : blockSizes) {
+        Storage storage(0, blockSize);
+        mt19937 rng(42);
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int i = 0; i < numRecords; i++) {
+            Record *record = storage.getRecord(storage.addRecord(sizeof(Record)));
+            record->averageRating = (rng() % 91 + 10) / 10.0f;
+            record->numVotes = rng() % 100000;
+        }
+        double loadSeconds = getSeconds(start);
+
+        vector<RID> rids;
+        rids.reserve(numRecords);
+        storage.getRIDs(rids);
+        long long sum = 0;
+        start = chrono::steady_clock::now();
+        for (RID rid : rids) {
+            sum += storage.getRecord(rid)->numVotes;
+        }
+        double sweepSeconds = getSeconds(start);
+
+        start = chrono::steady_clock::now();
+        for (int i = 0; i < numLookups; i++) {
+            sum += storage.getRecord(rids[rng() % rids.size()])->numVotes;
+        }
+        double lookupSeconds = getSeconds(start);
+
+        cout << blockSize << "\t\t" << storage.getNumRecords() << "\t" << storage.getBlocksUsed() << "\t\t"
+             << storage.getStorageSizeAllocated() / 1000000 << "\t\t" << loadSeconds << "\t" << sweepSeconds << "\t"
+             << (long long)(numLookups / lookupSeconds) << "\t(" << sum << ")" << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+// Point lookup throughput of one key at a time against batched multiSearch.
+// The one-key baseline calls multiSearch with a single key, since search throws on a miss.
+// Build from the repository root:
+//   g++ -O2 -pthread bench/bench_multisearch.cpp bptree.cpp bufferpool.cpp epoch.cpp nodearena.cpp nodesearch.cpp posting.cpp storage.cpp mappedfile.cpp -o bench_multisearch
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../bptree.h"
+#include "../storage.h"
+
+using namespace std;
+
+int main() {
+    const int numKeys = 4000000;
+    const int numLookups = 2000000;
+    int blockSizes[] = {200, 500};
+    int batchSizes[] = {100, 1000, 10000, 100000};
+
+    // distinct keys with one record each, half of the lookups miss
+    mt19937 rng(42);
+    vector<int> lookups(numLookups);
+    for (int i = 0; i < numLookups; i++) {
+        lookups[i] = rng() % (numKeys * 2);
+    }
+
+    cout << "block size\tbatch\tone key/s\tmultiSearch/s\tfound" << endl;
+    for (int blockSize : blockSizes) {
+        Storage storage(100000000, blockSize);
+        vector<RID> dataEntries;
+        for (int i = 0; i < numKeys; i++) {
+            RID rid = storage.addRecord(sizeof(Record));
+            storage.getRecord(rid)->numVotes = i * 2;
+            dataEntries.push_back(rid);
+        }
+        BPTree bptree(&storage);
+        bptree.bulkLoad(dataEntries, 1.0);
+
+        // one key per call, each descent waits on its own cache misses
+        int numFound = 0;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int i = 0; i < numLookups; i++) {
+            void *slot;
+            bptree.multiSearch(&lookups[i], 1, &slot);
+            numFound += (slot != nullptr);
+        }
+        double searchSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        for (int batchSize : batchSizes) {
+            vector<void *> slots(batchSize);
+            int numMultiFound = 0;
+            start = chrono::steady_clock::now();
+            for (int first = 0; first < numLookups; first += batchSize) {
+                int n = min(batchSize, numLookups - first);
+                bptree.multiSearch(lookups.data() + first, n, slots.data());
+                for (int i = 0; i < n; i++) {
+                    numMultiFound += (slots[i] != nullptr);
+                }
+            }
+            double multiSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+            cout << blockSize << "\t\t" << batchSize << "\t" << (long long)(numLookups / searchSeconds) << "\t\t"
+                 << (long long)(numLookups / multiSeconds) << "\t\t" << numMultiFound << "/" << numFound << endl;
+        }
+    }
+    return 0;
+}
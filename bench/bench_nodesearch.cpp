@@ -0,0 +1,57 @@
+// Compare node search kernels on point lookups for several block sizes.
+// Build from the repository root:
+//   g++ -O2 -pthread bench/bench_nodesearch.cpp bptree.cpp bufferpool.cpp epoch.cpp nodearena.cpp nodesearch.cpp posting.cpp storage.cpp mappedfile.cpp -o bench_nodesearch
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "../bptree.h"
+#include "../nodesearch.h"
+#include "../storage.h"
+
+using namespace std;
+
+int main() {
+    const int numKeys = 1000000;
+    const int numLookups = 2000000;
+    int blockSizes[] = {200, 500, 4096, 16384};
+    const char *modeNames[] = {"linear", "binary", "simd"};
+
+    srand(42);
+    vector<int> keys(numKeys);
+    for (int i = 0; i < numKeys; i++) {
+        keys[i] = i * 3;
+    }
+    vector<int> lookups(numLookups);
+    for (int i = 0; i < numLookups; i++) {
+        lookups[i] = keys[rand() % numKeys];
+    }
+
+    cout << "block size\tn\tkernel\tlookups/s" << endl;
+    for (int blockSize : blockSizes) {
+        Storage storage(100000000, blockSize);
+        vector<RID> dataEntries;
+        for (int i = 0; i < numKeys; i++) {
+            RID rid = storage.addRecord(sizeof(Record));
+            storage.getRecord(rid)->numVotes = keys[i];
+            dataEntries.push_back(rid);
+        }
+        BPTree bptree(&storage);
+        bptree.bulkLoad(dataEntries, 1.0);
+
+        for (int mode = LINEAR_SEARCH; mode <= SIMD_SEARCH; mode++) {
+            setNodeSearchMode((NodeSearchMode)mode);
+            long long found = 0;
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            for (int i = 0; i < numLookups; i++) {
+                found += (bptree.search(lookups[i]) != nullptr);
+            }
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            cout << blockSize << "\t\t" << bptree.getMaxKeys() << "\t" << modeNames[mode] << "\t" << (long long)(numLookups / seconds)
+                 << (found == 0 ? " (no keys found)" : "") << endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+// Full-table BlockScan and BPTree aggregates over row blocks and PAX blocks. A PAX block keeps each field
+// in its own minipage, so a scan over numVotes and averageRating leaves the tconst minipage unread.
+// The cache lines a scan touches per block stand in for its memory traffic.
+// Build from the repository root:
+//   g++ -O2 -pthread bench/bench_pax.cpp blockscan.cpp bptree.cpp bufferpool.cpp epoch.cpp nodearena.cpp nodesearch.cpp posting.cpp storage.cpp mappedfile.cpp -o bench_pax
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../blockscan.h"
+#include "../bptree.h"
+#include "../storage.h"
+
+using namespace std;
+
+#define CACHE_LINE_SIZE 64
+
+// average seconds of numRuns calls of fn
+static double timeRuns(int numRuns, const function<void()> &fn) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int run = 0; run < numRuns; run++) {
+        fn();
+    }
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count() / numRuns;
+}
+
+// cache lines holding bytes [offset, offset + size) of a block starting at a cache line
+static int getCacheLines(int offset, int size) {
+    return (offset + size - 1) / CACHE_LINE_SIZE - offset / CACHE_LINE_SIZE + 1;
+}
+
+int main() {
+    int numRecords = 10000000;
+    int numRuns = 5;
+    int blockSizes[] = {200, 500};
+    BlockFormat formats[] = {ROW_BLOCKS, PAX_BLOCKS};
+
+    cout << "block size\tformat\tblocks\tMB\tlines/block\tscan ms\tMrecords/s\tindex ms" << endl;
+    for (int blockSize : blockSizes) {
+        for (BlockFormat format : formats) {
+            // numVotes skewed towards small values and ratings around 6.5 like the IMDb data
+            Storage storage(0, blockSize, format);
+            vector<RID> dataEntries;
+            mt19937 rng(42);
+            exponential_distribution<double> votes(1.0 / 10000);
+            normal_distribution<double> rating(6.5, 1.2);
+            for (int i = 0; i < numRecords; i++) {
+                Record record;
+                snprintf(record.tconst, sizeof(record.tconst), "tt%07d", i % 10000000);
+                record.averageRating = round(min(10.0, max(1.0, rating(rng))) * 10) / 10;
+                record.numVotes = 5 + (int)votes(rng);
+                RID rid = storage.addRecord(sizeof(Record));
+                storage.writeRecord(rid, record);
+                dataEntries.push_back(rid);
+            }
+            BPTree bptree(&storage);
+            bptree.bulkLoad(dataEntries, 1.0);
+            BlockScan blockScan(&storage, false);
+
+            // a row scan reads every record whole, a PAX scan the numVotes and averageRating minipages
+            int numLines = getCacheLines(0, storage.getMaxRecordsPerBlock() * sizeof(Record));
+            if (format == PAX_BLOCKS) {
+                const PaxLayout &pax = storage.getPaxLayout();
+                numLines = getCacheLines(pax.ratingsOffset, pax.numRecords * sizeof(float) + pax.numRecords * sizeof(int));
+            }
+
+            ScanPredicate highRating;
+            highRating.minRating = 8.0;
+            Aggregate scanned;
+            double scanSeconds = timeRuns(numRuns, [&]() { scanned = blockScan.aggregate(highRating, NUM_VOTES); });
+
+            Aggregate indexed;
+            double indexSeconds = timeRuns(numRuns, [&]() { indexed = bptree.aggregate(30000, 40000, AVERAGE_RATING); });
+
+            cout << blockSize << "\t\t" << (format == PAX_BLOCKS ? "PAX" : "row") << "\t" << storage.getBlocksUsed() << "\t"
+                 << storage.getStorageSizeAllocated() / 1000000 << "\t" << numLines << "/" << getCacheLines(0, blockSize)
+                 << "\t\t" << scanSeconds * 1e3 << "\t" << numRecords / scanSeconds / 1e6 << "\t\t" << indexSeconds * 1e3
+                 << "\t(" << scanned.count << ", " << indexed.count << ")" << endl;
+        }
+    }
+    return 0;
+}
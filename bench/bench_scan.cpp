@@ -0,0 +1,102 @@
+// Latency of the Experiment 4 range query, streamed through BPTreeCursor,
+// as a BPTree::aggregate, as an aggregateParallel on all hardware threads,
+// as a countRange on an augmented tree and through searchExp with its log file.
+// Build from the repository root:
+//   g++ -O2 -pthread bench/bench_scan.cpp bptree.cpp bufferpool.cpp epoch.cpp nodearena.cpp nodesearch.cpp posting.cpp storage.cpp mappedfile.cpp -o bench_scan
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../bptree.h"
+#include "../parallel.h"
+#include "../storage.h"
+
+using namespace std;
+
+int main() {
+    int numRecords = 1000000;
+    int blockSizes[] = {200, 500};
+    int numRuns = 20;
+
+    cout << "block size\trecords\tcursor us\taggregate us\tparallel us\tcountRange us\tsearchExp us" << endl;
+    for (int blockSize : blockSizes) {
+        // numVotes skewed towards small values like the IMDb data
+        Storage storage(100000000, blockSize);
+        vector<RID> dataEntries;
+        mt19937 rng(42);
+        exponential_distribution<double> votes(1.0 / 10000);
+        for (int i = 0; i < numRecords; i++) {
+            RID rid = storage.addRecord(sizeof(Record));
+            Record *record = storage.getRecord(rid);
+            snprintf(record->tconst, sizeof(record->tconst), "tt%07d", i);
+            record->averageRating = (rng() % 91 + 10) / 10.0f;
+            record->numVotes = 5 + (int)votes(rng);
+            dataEntries.push_back(rid);
+        }
+
+        BPTree bptree(&storage);
+        bptree.bulkLoad(dataEntries, 1.0);
+
+        // stream the range and average the ratings without any output
+        int numMatched = 0;
+        double ratingSum = 0;
+        BPTreeCursor cursor(&bptree);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int run = 0; run < numRuns; run++) {
+            numMatched = 0;
+            ratingSum = 0;
+            RID batch[256];
+            int n;
+            cursor.seek(30000, 40000);
+            while ((n = cursor.nextN(batch, 256)) > 0) {
+                for (int i = 0; i < n; i++) {
+                    ratingSum += storage.getRecord(batch[i])->averageRating;
+                }
+                numMatched += n;
+            }
+        }
+        double cursorSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() / numRuns;
+
+        Aggregate rating;
+        start = chrono::steady_clock::now();
+        for (int run = 0; run < numRuns; run++) {
+            rating = bptree.aggregate(30000, 40000, AVERAGE_RATING);
+        }
+        double aggregateSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() / numRuns;
+
+        Aggregate parallelRating;
+        start = chrono::steady_clock::now();
+        for (int run = 0; run < numRuns; run++) {
+            parallelRating = bptree.aggregateParallel(30000, 40000, AVERAGE_RATING, getNumThreads());
+        }
+        double parallelSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() / numRuns;
+
+        // the augmented tree only reads records in the two boundary leaves
+        BPTree augmentedTree(&storage, true);
+        augmentedTree.bulkLoad(dataEntries, 1.0);
+        Aggregate counted;
+        start = chrono::steady_clock::now();
+        for (int run = 0; run < numRuns; run++) {
+            counted = augmentedTree.countRange(30000, 40000);
+        }
+        double countSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() / numRuns;
+
+        start = chrono::steady_clock::now();
+        for (int run = 0; run < numRuns; run++) {
+            bptree.searchExp(30000, 40000, "bench_scan");
+        }
+        double searchSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() / numRuns;
+        std::remove("bench_scan.txt");
+
+        cout << blockSize << "\t\t" << numMatched << "\t" << (long long)(cursorSeconds * 1e6) << "\t\t"
+             << (long long)(aggregateSeconds * 1e6) << "\t\t" << (long long)(parallelSeconds * 1e6) << "\t\t" << countSeconds * 1e6 << "\t\t"
+             << (long long)(searchSeconds * 1e6) << "\t(avg rating " << ratingSum / numMatched << ", aggregate " << rating.average() << " over "
+             << rating.numDataBlocks << " blocks, parallel " << parallelRating.average() << " over "
+             << parallelRating.numDataBlocks << " blocks, countRange " << counted.average() << " from "
+             << counted.numIndexNodes << " nodes)" << endl;
+    }
+    return 0;
+}
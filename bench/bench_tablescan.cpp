@@ -0,0 +1,109 @@
+// Full-table BlockScan reading every block against the BPTree for the Experiment 4 range, and alone for
+// a predicate on averageRating the index cannot answer.
+// Build from the repository root, add -DBLOCK_SCAN_SIMD=0 to compare with the scalar selection:
+//   g++ -O2 -pthread bench/bench_tablescan.cpp blockscan.cpp bptree.cpp bufferpool.cpp epoch.cpp nodearena.cpp nodesearch.cpp posting.cpp storage.cpp mappedfile.cpp -o bench_tablescan
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "../blockscan.h"
+#include "../bptree.h"
+#include "../parallel.h"
+#include "../storage.h"
+
+using namespace std;
+
+// average seconds of numRuns calls of fn
+static double timeRuns(int numRuns, const function<void()> &fn) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int run = 0; run < numRuns; run++) {
+        fn();
+    }
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count() / numRuns;
+}
+
+int main() {
+    int numRecords = 1000000;
+    int numRuns = 10;
+    int numThreads = getNumThreads();
+    int blockSizes[] = {200, 500};
+
+    cout << "simd " << BLOCK_SCAN_SIMD << ", threads " << numThreads << endl;
+    cout << "block size\tquery\t\t\tplan\t\t\tmatches\tblocks\tms\tMrecords/s\tGB/s" << endl;
+    for (int blockSize : blockSizes) {
+        // numVotes skewed towards small values and ratings around 6.5 like the IMDb data
+        Storage storage(0, blockSize);
+        vector<RID> dataEntries;
+        mt19937 rng(42);
+        exponential_distribution<double> votes(1.0 / 10000);
+        normal_distribution<double> rating(6.5, 1.2);
+        for (int i = 0; i < numRecords; i++) {
+            RID rid = storage.addRecord(sizeof(Record));
+            Record *record = storage.getRecord(rid);
+            snprintf(record->tconst, sizeof(record->tconst), "tt%07d", i % 10000000);
+            record->averageRating = round(min(10.0, max(1.0, rating(rng))) * 10) / 10;
+            record->numVotes = 5 + (int)votes(rng);
+            dataEntries.push_back(rid);
+        }
+        BPTree bptree(&storage);
+        bptree.bulkLoad(dataEntries, 1.0);
+        BlockScan blockScan(&storage, false);
+        double tableBytes = (double)storage.getBlocksUsed() * blockSize;
+
+        // throughput over the whole table, the scan reads every record whatever the predicate;
+        // searchExp returns no count of matches, it is given as -1
+        auto report = [&](const char *query, const char *plan, long long matches, int blocks, double seconds, bool fullScan) {
+            cout << blockSize << "\t\t" << query << "\t" << plan << "\t";
+            if (matches < 0) {
+                cout << "-";
+            } else {
+                cout << matches;
+            }
+            cout << "\t" << blocks << "\t" << seconds * 1e3 << "\t";
+            if (fullScan) {
+                cout << numRecords / seconds / 1e6 << "\t\t" << tableBytes / seconds / 1e9 << endl;
+            } else {
+                cout << "-\t\t-" << endl;
+            }
+        };
+
+        ScanPredicate exp4;
+        exp4.minVotes = 30000;
+        exp4.maxVotes = 40000;
+        tuple<int, int, float> traced;
+        double seconds = timeRuns(numRuns, [&]() {
+            traced = bptree.searchExp(exp4.minVotes, exp4.maxVotes, "bench_tablescan_exp4");
+        });
+        remove("bench_tablescan_exp4.txt");
+        report("votes 30000-40000", "index searchExp\t", -1, get<1>(traced), seconds, false);
+
+        Aggregate result;
+        seconds = timeRuns(numRuns, [&]() { result = bptree.aggregate(exp4.minVotes, exp4.maxVotes, AVERAGE_RATING); });
+        report("votes 30000-40000", "index aggregate\t", result.count, result.numDataBlocks, seconds, false);
+
+        Aggregate scanned;
+        seconds = timeRuns(numRuns, [&]() { scanned = blockScan.aggregate(exp4, AVERAGE_RATING); });
+        report("votes 30000-40000", "full scan\t", scanned.count, scanned.numDataBlocks, seconds, true);
+        if (scanned.count != result.count || fabs(scanned.sum - result.sum) > 1e-3 * result.count) {
+            cout << "Index and scan disagree" << endl;
+        }
+
+        seconds = timeRuns(numRuns, [&]() { scanned = blockScan.aggregateParallel(exp4, AVERAGE_RATING, numThreads); });
+        report("votes 30000-40000", "full scan parallel", scanned.count, scanned.numDataBlocks, seconds, true);
+
+        ScanPredicate highRating;
+        highRating.minRating = 8.0;
+        seconds = timeRuns(numRuns, [&]() { scanned = blockScan.aggregate(highRating, NUM_VOTES); });
+        report("rating >= 8.0\t", "full scan\t", scanned.count, scanned.numDataBlocks, seconds, true);
+
+        seconds = timeRuns(numRuns, [&]() { scanned = blockScan.aggregateParallel(highRating, NUM_VOTES, numThreads); });
+        report("rating >= 8.0\t", "full scan parallel", scanned.count, scanned.numDataBlocks, seconds, true);
+    }
+    return 0;
+}
@@ -0,0 +1,111 @@
+// Insert and delete throughput of BPTree as the tree grows, next to the baseline that searched
+// the tree recursively for the parent of a split or merged node (findParent, findParentInclLeaf).
+// Build from the repository root:
+//   g++ -O2 -pthread bench/bench_tree.cpp bptree.cpp bufferpool.cpp epoch.cpp nodearena.cpp nodesearch.cpp posting.cpp storage.cpp mappedfile.cpp -o bench_tree
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "../bptree.h"
+#include "../storage.h"
+
+using namespace std;
+
+// Baseline numbers, median of 3 runs of this benchmark built with -O2 on the tree before the
+// root-to-leaf path (commit dc53ba5); rerun it there to compare on other hardware.
+// Its remove lost keys (275 and 293 of 5000 not found at 10000 keys) and crashed from 20000 keys on,
+// so there are no baseline deletes for larger trees.
+struct Baseline {
+    int blockSize;
+    int numKeys;
+    long long insertsPerSecond;
+    long long deletesPerSecond;  // 0 if the baseline crashed
+};
+
+static const Baseline baselines[] = {
+    {200, 10000, 5987000, 1233000},
+    {200, 100000, 4294000, 0},
+    {200, 1000000, 1243000, 0},
+    {500, 10000, 5107000, 1600000},
+    {500, 100000, 4355000, 0},
+    {500, 1000000, 2099000, 0},
+};
+
+static const Baseline *findBaseline(int blockSize, int numKeys) {
+    for (const Baseline &baseline : baselines) {
+        if (baseline.blockSize == blockSize && baseline.numKeys == numKeys) {
+            return &baseline;
+        }
+    }
+    return nullptr;
+}
+
+int main() {
+    int treeSizes[] = {10000, 100000, 1000000};
+    int blockSizes[] = {200, 500};
+
+    cout << "block size\tkeys\tinserts/s\tdeletes/s\tbaseline inserts/s\tbaseline deletes/s" << endl;
+    for (int blockSize : blockSizes) {
+        for (int numKeys : treeSizes) {
+            // distinct keys in random order so that every insert adds a key
+            vector<int> keys(numKeys);
+            for (int i = 0; i < numKeys; i++) {
+                keys[i] = i;
+            }
+            mt19937 rng(42);
+            shuffle(keys.begin(), keys.end(), rng);
+            // records are never read by insert and remove, only their RIDs are stored
+            Storage storage(100000000, blockSize);
+            vector<RID> rids(numKeys);
+            for (int i = 0; i < numKeys; i++) {
+                rids[i] = storage.addRecord(sizeof(Record));
+            }
+
+            BPTree bptree(&storage);
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            for (int i = 0; i < numKeys; i++) {
+                Key newKey;
+                newKey.key_value = keys[i];
+                newKey.address.push_back(rids[i]);
+                bptree.insert(newKey);
+            }
+            double insertSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+            // delete half of the keys in a different random order
+            shuffle(keys.begin(), keys.end(), rng);
+            int numDeletes = numKeys / 2;
+            int numMissing = 0;  // keys the tree failed to find
+            start = chrono::steady_clock::now();
+            for (int i = 0; i < numDeletes; i++) {
+                try {
+                    bptree.remove(keys[i]);
+                } catch (const logic_error &e) {
+                    numMissing++;
+                }
+            }
+            double deleteSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+            cout << blockSize << "\t\t" << numKeys << "\t" << (long long)(numKeys / insertSeconds) << "\t\t"
+                 << (long long)(numDeletes / deleteSeconds);
+            const Baseline *baseline = findBaseline(blockSize, numKeys);
+            if (baseline != nullptr) {
+                cout << "\t\t" << baseline->insertsPerSecond << "\t\t\t";
+                if (baseline->deletesPerSecond > 0) {
+                    cout << baseline->deletesPerSecond;
+                } else {
+                    cout << "crashed";
+                }
+            }
+            if (numMissing > 0) {
+                cout << "\t(" << numMissing << " keys not found)";
+            }
+            cout << endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+// Data blocks accessed by a range query on slotted storage before and after a vacuum.
+// 60% of the keys are removed from the BPTree (deleting their records), then the vacuum
+// runs in 1 ms slices with the range query answered between slices.
+// Build from the repository root:
+//   g++ -O2 -pthread bench/bench_vacuum.cpp bptree.cpp bufferpool.cpp epoch.cpp nodearena.cpp nodesearch.cpp posting.cpp storage.cpp mappedfile.cpp vacuum.cpp -o bench_vacuum
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "../bptree.h"
+#include "../storage.h"
+#include "../vacuum.h"
+
+using namespace std;
+
+// blocks with at least one live record
+static int getNumLiveBlocks(Storage &storage) {
+    int numBlocks = 0;
+    for (int blockNum = 0; blockNum < storage.getBlocksUsed(); blockNum++) {
+        numBlocks += (storage.getNumLiveRecords(blockNum) > 0);
+    }
+    return numBlocks;
+}
+
+int main() {
+    int numRecords = 1000000;
+    int maxVotes = 100000;
+    int blockSizes[] = {200, 500};
+
+    cout << "block size\tlive blocks\tquery blocks\tquery us\tslices\tmax slice us\tmax query us\tmoved" << endl;
+    for (int blockSize : blockSizes) {
+        Storage storage(100000000, blockSize, SLOTTED_BLOCKS);
+        vector<RID> dataEntries;
+        mt19937 rng(42);
+        for (int i = 0; i < numRecords; i++) {
+            RID rid = storage.addRecord(sizeof(Record));
+            Record *record = storage.getRecord(rid);
+            record->averageRating = (rng() % 91 + 10) / 10.0f;
+            record->numVotes = rng() % maxVotes;
+            dataEntries.push_back(rid);
+        }
+        BPTree bptree(&storage);
+        bptree.bulkLoad(dataEntries, 1.0);
+
+        vector<int> keys(maxVotes);
+        for (int i = 0; i < maxVotes; i++) {
+            keys[i] = i;
+        }
+        shuffle(keys.begin(), keys.end(), rng);
+        for (int i = 0; i < maxVotes * 6 / 10; i++) {
+            try {
+                bptree.remove(keys[i]);
+            } catch (const logic_error &e) {  // no record has this key
+            }
+        }
+
+        auto query = [&](Aggregate &result) {
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            result = bptree.aggregate(30000, 40000, AVERAGE_RATING);
+            return chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e6;
+        };
+
+        Aggregate before;
+        double beforeUs = query(before);
+        cout << blockSize << "\t\t" << getNumLiveBlocks(storage) << "\t\t" << before.numDataBlocks << "\t\t"
+             << (long long)beforeUs << "\t\tbefore vacuum" << endl;
+
+        Vacuum vacuum(&storage, &bptree);
+        int numSlices = 0;
+        double maxSliceUs = 0, maxQueryUs = 0;
+        bool done = false;
+        while (!done) {
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            done = vacuum.runSlice(chrono::microseconds(1000));
+            maxSliceUs = max(maxSliceUs, chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e6);
+            numSlices++;
+
+            Aggregate during;
+            maxQueryUs = max(maxQueryUs, query(during));
+            if (during.count != before.count) {
+                cout << "Range query changed during the vacuum" << endl;
+            }
+        }
+
+        Aggregate after;
+        double afterUs = query(after);
+        cout << blockSize << "\t\t" << getNumLiveBlocks(storage) << "\t\t" << after.numDataBlocks << "\t\t"
+             << (long long)afterUs << "\t\t" << numSlices << "\t" << (long long)maxSliceUs << "\t\t"
+             << (long long)maxQueryUs << "\t\t" << vacuum.getNumMoved() << "\t(avg rating " << before.average()
+             << " -> " << after.average() << ")" << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,105 @@
+// Blocks read and latency of predicates answered by the BPTree and by a BlockScan skipping blocks
+// with zone maps, with records in load order and clustered in numVotes order.
+// Build from the repository root:
+//   g++ -O2 -pthread bench/bench_zonemap.cpp blockscan.cpp bptree.cpp bufferpool.cpp epoch.cpp nodearena.cpp nodesearch.cpp posting.cpp storage.cpp mappedfile.cpp -o bench_zonemap
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../blockscan.h"
+#include "../bptree.h"
+#include "../storage.h"
+
+using namespace std;
+
+struct Query {
+    const char *name;
+    ScanPredicate predicate;
+    bool indexed;  // the predicate is a numVotes range the BPTree can answer
+};
+
+int main() {
+    int numRecords = 1000000;
+    int numRuns = 5;
+    int blockSizes[] = {200, 500};
+
+    vector<Query> queries(4);
+    queries[0].name = "rating >= 9.5";
+    queries[0].predicate.minRating = 9.5;
+    queries[0].indexed = false;
+    queries[1].name = "votes 30000-40000";
+    queries[1].predicate.minVotes = 30000;
+    queries[1].predicate.maxVotes = 40000;
+    queries[1].indexed = true;
+    queries[2].name = "votes 100-100000";
+    queries[2].predicate.minVotes = 100;
+    queries[2].predicate.maxVotes = 100000;
+    queries[2].indexed = true;
+    queries[3].name = "votes >= 50000, rating >= 8";
+    queries[3].predicate.minVotes = 50000;
+    queries[3].predicate.minRating = 8;
+    queries[3].indexed = false;
+
+    cout << "block size\tlayout\t\tquery\t\t\t\tmatches\tblocks\tscan blocks\tindex blocks\tscan us\tindex us\tchoice" << endl;
+    for (int blockSize : blockSizes) {
+        // numVotes skewed towards small values and ratings around 6.5 like the IMDb data
+        Storage storage(0, blockSize);
+        vector<RID> dataEntries;
+        mt19937 rng(42);
+        exponential_distribution<double> votes(1.0 / 10000);
+        normal_distribution<double> rating(6.5, 1.2);
+        for (int i = 0; i < numRecords; i++) {
+            RID rid = storage.addRecord(sizeof(Record));
+            Record *record = storage.getRecord(rid);
+            snprintf(record->tconst, sizeof(record->tconst), "tt%07d", i);
+            record->averageRating = round(min(10.0, max(1.0, rating(rng))) * 10) / 10;
+            record->numVotes = 5 + (int)votes(rng);
+            dataEntries.push_back(rid);
+        }
+        BPTree bptree(&storage);
+        bptree.bulkLoad(dataEntries, 1.0);
+        BlockScan blockScan(&storage);
+
+        for (int layout = 0; layout < 2; layout++) {
+            if (layout == 1) {
+                bptree.cluster();
+            }
+            for (Query &query : queries) {
+                Aggregate scanned;
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                for (int run = 0; run < numRuns; run++) {
+                    scanned = blockScan.aggregate(query.predicate, AVERAGE_RATING);
+                }
+                double scanUs = chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e6 / numRuns;
+
+                Aggregate indexed;
+                double indexUs = 0;
+                if (query.indexed) {
+                    start = chrono::steady_clock::now();
+                    for (int run = 0; run < numRuns; run++) {
+                        indexed = bptree.aggregate(query.predicate.minVotes, query.predicate.maxVotes, AVERAGE_RATING);
+                    }
+                    indexUs = chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e6 / numRuns;
+                    if (indexed.count != scanned.count) {
+                        cout << "Index and scan disagree" << endl;
+                    }
+                }
+
+                cout << blockSize << "\t\t" << (layout == 0 ? "load order" : "clustered") << "\t" << query.name << "\t\t"
+                     << (query.name[0] == 'r' ? "\t\t" : "") << scanned.count << "\t" << storage.getBlocksUsed() << "\t"
+                     << scanned.numDataBlocks << "\t\t";
+                if (query.indexed) {
+                    cout << indexed.numDataBlocks << "\t\t" << (long long)scanUs << "\t" << (long long)indexUs << "\t"
+                         << (blockScan.preferScan(query.predicate) ? "scan" : "index") << endl;
+                } else {
+                    cout << "-\t\t" << (long long)scanUs << "\t-\tscan" << endl;
+                }
+            }
+        }
+    }
+    return 0;
+}
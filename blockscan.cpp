@@ -0,0 +1,309 @@
+#include "blockscan.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "bptree.h"
+#include "bufferpool.h"
+#include "parallel.h"
+#include "rid.h"
+#include "storage.h"
+
+using namespace std;
+
+#if BLOCK_SCAN_SIMD && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BLOCK_SCAN_AVX2
+#endif
+
+#ifdef BLOCK_SCAN_AVX2
+//Check once if the CPU runs AVX2
+static bool hasAvx2(){
+    static bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+//Lanes of every 8-bit match mask moved to the front, for compressing positions into a selection vector
+struct CompressTable {
+    int lanes[256][8];
+
+    CompressTable(){
+        for (int mask = 0; mask < 256; mask++){
+            int n = 0;
+            for (int lane = 0; lane < 8; lane++){
+                if (mask & (1 << lane)){
+                    lanes[mask][n++] = lane;
+                }
+            }
+            while (n < 8){
+                lanes[mask][n++] = 0;
+            }
+        }
+    }
+};
+
+static const CompressTable compressTable;
+
+//Compare 8 records per step, the positions of the matching lanes go to the end of selection
+__attribute__((target("avx2"))) static int selectAvx2(const ScanBatch &batch, const ScanPredicate &predicate, int *selection){
+    __m256i minVotes = _mm256_set1_epi32(predicate.minVotes);
+    __m256i maxVotes = _mm256_set1_epi32(predicate.maxVotes);
+    __m256 minRating = _mm256_set1_ps(predicate.minRating);
+    __m256 maxRating = _mm256_set1_ps(predicate.maxRating);
+    __m256i step = _mm256_set1_epi32(8);
+    __m256i positions = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    int numSelected = 0;
+    int i = 0;
+    for (; i + 8 <= batch.numRecords; i += 8){
+        __m256i votes = _mm256_loadu_si256((const __m256i *)(batch.votes + i));
+        __m256 ratings = _mm256_loadu_ps(batch.ratings + i);
+        __m256i votesFail = _mm256_or_si256(_mm256_cmpgt_epi32(minVotes, votes), _mm256_cmpgt_epi32(votes, maxVotes));
+        __m256 ratingsPass = _mm256_and_ps(_mm256_cmp_ps(ratings, minRating, _CMP_GE_OQ), _mm256_cmp_ps(ratings, maxRating, _CMP_LE_OQ));
+        int mask = _mm256_movemask_ps(_mm256_andnot_ps(_mm256_castsi256_ps(votesFail), ratingsPass));
+        //selection has room for 8 more positions, it never gets ahead of i
+        __m256i lanes = _mm256_loadu_si256((const __m256i *) compressTable.lanes[mask]);
+        _mm256_storeu_si256((__m256i *)(selection + numSelected), _mm256_permutevar8x32_epi32(positions, lanes));
+        numSelected += __builtin_popcount(mask);
+        positions = _mm256_add_epi32(positions, step);
+    }
+    for (; i < batch.numRecords; i++){
+        selection[numSelected] = i;
+        numSelected += batch.votes[i] >= predicate.minVotes && batch.votes[i] <= predicate.maxVotes
+                    && batch.ratings[i] >= predicate.minRating && batch.ratings[i] <= predicate.maxRating;
+    }
+    return numSelected;
+}
+#endif
+
+//BlockScan Constructor
+BlockScan::BlockScan(Storage *storage, bool useZoneMaps){
+    __storage = storage;
+    __useZoneMaps = useZoneMaps;
+}
+
+//Check if the bounds of a block overlap the predicate
+bool BlockScan::mayMatch(const ZoneMap &zoneMap, const ScanPredicate &predicate){
+    return zoneMap.numRecords > 0
+        && zoneMap.maxVotes >= predicate.minVotes && zoneMap.minVotes <= predicate.maxVotes
+        && zoneMap.maxRating >= predicate.minRating && zoneMap.minRating <= predicate.maxRating;
+}
+
+//Build the selection vector of a batch, without branching on the outcome
+int BlockScan::select(const ScanBatch &batch, const ScanPredicate &predicate, int *selection){
+#ifdef BLOCK_SCAN_AVX2
+    if (hasAvx2()){
+        return selectAvx2(batch, predicate, selection);
+    }
+#endif
+    int numSelected = 0;
+    for (int i = 0; i < batch.numRecords; i++){
+        selection[numSelected] = i;
+        numSelected += batch.votes[i] >= predicate.minVotes && batch.votes[i] <= predicate.maxVotes
+                    && batch.ratings[i] >= predicate.minRating && batch.ratings[i] <= predicate.maxRating;
+    }
+    return numSelected;
+}
+
+void BlockScan::addSelected(const ScanBatch &batch, const int *selection, int numSelected, RecordField field, Aggregate &result){
+    double sum = 0;
+    double minValue = result.min;
+    double maxValue = result.max;
+    for (int i = 0; i < numSelected; i++){
+        double value = (field == AVERAGE_RATING) ? batch.ratings[selection[i]] : batch.votes[selection[i]];
+        sum += value;
+        minValue = std::min(minValue, value);
+        maxValue = std::max(maxValue, value);
+    }
+    result.count += numSelected;
+    result.sum += sum;
+    result.min = minValue;
+    result.max = maxValue;
+}
+
+//Copy the fields of each block read into the batch, running the predicate whenever the next block might not fit
+int BlockScan::scanBlocks(int firstBlock, int lastBlock, const ScanPredicate &predicate, BufferPool *bufferPool,
+                          const function<void(const ScanBatch &, const int *, int)> &fn){
+    ScanBatch *batch = new ScanBatch();
+    vector<int> selection(BLOCK_SCAN_BATCH_SIZE);
+    int maxSlots = __storage->getMaxSlotsPerBlock();
+    vector<int> slots(maxSlots);
+    vector<int> offsets(maxSlots);
+    bool isPax = __storage->getBlockFormat() == PAX_BLOCKS;
+    bool isCompact = __storage->getRecordEncoding() == COMPACT_RECORDS;
+    bool isCompressed = __storage->getBlockFormat() == COMPRESSED_BLOCKS;
+    const PaxLayout &pax = __storage->getPaxLayout();
+    int numBlocks = 0;
+
+    batch->numRecords = 0;
+    for (int blockNum = firstBlock; blockNum < lastBlock; blockNum++){
+        if (__useZoneMaps && !mayMatch(__storage->getZoneMap(blockNum), predicate)){
+            continue;
+        }
+        if (batch->numRecords + __storage->getNumLiveRecords(blockNum) > BLOCK_SCAN_BATCH_SIZE){
+            fn(*batch, selection.data(), select(*batch, predicate, selection.data()));
+            batch->numRecords = 0;
+        }
+
+        //read the data block through the buffer pool instead of the in-memory copy
+        uchar *block = __storage->getBlockAddress(blockNum);
+        uchar *frame = (bufferPool != nullptr) ? bufferPool->pinBlock(blockNum) : nullptr;
+        if (frame != nullptr){
+            block = frame;
+        }
+        int *votes = batch->votes + batch->numRecords;
+        float *ratings = batch->ratings + batch->numRecords;
+        RID *rids = batch->rids + batch->numRecords;
+        int numRecords;
+        if (isCompressed){ //columns are unpacked straight into the batch, tconst is never read
+            numRecords = __storage->decodeColumns(block, votes, ratings);
+            for (int i = 0; i < numRecords; i++){
+                rids[i] = makeRID(blockNum, i);
+            }
+        }
+        else if (isPax){ //minipages already are columns, tconst is never read
+            numRecords = __storage->getNumLiveRecords(blockNum);
+            memcpy(votes, block + pax.votesOffset, numRecords * sizeof(int));
+            if (isCompact){
+                const uint16_t *compactRatings = (const uint16_t *)(block + pax.ratingsOffset);
+                for (int i = 0; i < numRecords; i++){
+                    ratings[i] = decodeCompactRating(compactRatings[i]);
+                }
+            }
+            else{
+                memcpy(ratings, block + pax.ratingsOffset, numRecords * sizeof(float));
+            }
+            for (int i = 0; i < numRecords; i++){
+                rids[i] = makeRID(blockNum, i);
+            }
+        }
+        else if (isCompact){
+            numRecords = __storage->getLiveRecords(blockNum, block, slots.data(), offsets.data());
+            for (int i = 0; i < numRecords; i++){
+                const CompactRecord *record = (const CompactRecord *)(block + offsets[i]);
+                votes[i] = record->numVotes;
+                ratings[i] = decodeCompactRating(record->averageRating);
+                rids[i] = makeRID(blockNum, slots[i]);
+            }
+        }
+        else{
+            numRecords = __storage->getLiveRecords(blockNum, block, slots.data(), offsets.data());
+            for (int i = 0; i < numRecords; i++){
+                const Record *record = (const Record *)(block + offsets[i]);
+                votes[i] = record->numVotes;
+                ratings[i] = record->averageRating;
+                rids[i] = makeRID(blockNum, slots[i]);
+            }
+        }
+        batch->numRecords += numRecords;
+        if (frame != nullptr){
+            bufferPool->unpinBlock(blockNum, false);
+        }
+        numBlocks++;
+    }
+    if (batch->numRecords > 0){
+        fn(*batch, selection.data(), select(*batch, predicate, selection.data()));
+    }
+    delete batch;
+    return numBlocks;
+}
+
+//Aggregate the selection of every batch
+Aggregate BlockScan::aggregate(const ScanPredicate &predicate, RecordField field, BufferPool *bufferPool){
+    Aggregate result = newAggregate();
+    if (__useZoneMaps){
+        __storage->refreshZoneMaps();
+    }
+    result.numDataBlocks = scanBlocks(0, __storage->getBlocksUsed(), predicate, bufferPool,
+                                      [&](const ScanBatch &batch, const int *selection, int numSelected){
+        addSelected(batch, selection, numSelected, field, result);
+    });
+    return result;
+}
+
+//Scan a few block ranges per thread and merge their aggregates
+Aggregate BlockScan::aggregateParallel(const ScanPredicate &predicate, RecordField field, int numThreads){
+    if (__useZoneMaps){
+        __storage->refreshZoneMaps();
+    }
+    int numBlocks = __storage->getBlocksUsed();
+    int numParts = max(1, min(numThreads * 4, numBlocks));
+    vector<Aggregate> partials(numParts, newAggregate());
+    parallelFor(numParts, numThreads, [&](int p){
+        Aggregate &partial = partials[p];
+        partial.numDataBlocks = scanBlocks((long long) numBlocks * p / numParts, (long long) numBlocks * (p + 1) / numParts,
+                                           predicate, nullptr, [&](const ScanBatch &batch, const int *selection, int numSelected){
+            addSelected(batch, selection, numSelected, field, partial);
+        });
+    });
+
+    Aggregate result = partials[0];
+    for (int p = 1; p < numParts; p++){
+        result.count += partials[p].count;
+        result.sum += partials[p].sum;
+        result.min = std::min(result.min, partials[p].min);
+        result.max = std::max(result.max, partials[p].max);
+        result.numDataBlocks += partials[p].numDataBlocks;
+    }
+    return result;
+}
+
+//Collect the RIDs of the selection of every batch
+vector<RID> BlockScan::search(const ScanPredicate &predicate){
+    vector<RID> matching;
+    if (__useZoneMaps){
+        __storage->refreshZoneMaps();
+    }
+    scanBlocks(0, __storage->getBlocksUsed(), predicate, nullptr, [&](const ScanBatch &batch, const int *selection, int numSelected){
+        for (int i = 0; i < numSelected; i++){
+            matching.push_back(batch.rids[selection[i]]);
+        }
+    });
+    return matching;
+}
+
+//Count blocks whose zone map overlaps the predicate
+int BlockScan::getNumCandidateBlocks(const ScanPredicate &predicate){
+    __storage->refreshZoneMaps();
+    int numBlocks = 0;
+    for (int blockNum = 0; blockNum < __storage->getBlocksUsed(); blockNum++){
+        numBlocks += mayMatch(__storage->getZoneMap(blockNum), predicate);
+    }
+    return numBlocks;
+}
+
+//Sum over the candidate blocks of their records times the share of their bounds inside the predicate
+double BlockScan::estimateMatches(const ScanPredicate &predicate){
+    __storage->refreshZoneMaps();
+    double numMatches = 0;
+    for (int blockNum = 0; blockNum < __storage->getBlocksUsed(); blockNum++){
+        const ZoneMap &zoneMap = __storage->getZoneMap(blockNum);
+        if (!mayMatch(zoneMap, predicate)){
+            continue;
+        }
+        double votesShare = (max(min((double) zoneMap.maxVotes, (double) predicate.maxVotes) - max((double) zoneMap.minVotes, (double) predicate.minVotes), 0.0) + 1)
+                          / ((double) zoneMap.maxVotes - zoneMap.minVotes + 1);
+        double ratingShare = 1;
+        if (zoneMap.maxRating > zoneMap.minRating){
+            ratingShare = (min(zoneMap.maxRating, predicate.maxRating) - max(zoneMap.minRating, predicate.minRating))
+                        / (zoneMap.maxRating - zoneMap.minRating);
+        }
+        numMatches += zoneMap.numRecords * min(votesShare, 1.0) * ratingShare;
+    }
+    return numMatches;
+}
+
+//Compare records checked by the scan with the matches the index visits at random
+bool BlockScan::preferScan(const ScanPredicate &predicate){
+    __storage->refreshZoneMaps();
+    long long numCandidates = 0;
+    for (int blockNum = 0; blockNum < __storage->getBlocksUsed(); blockNum++){
+        const ZoneMap &zoneMap = __storage->getZoneMap(blockNum);
+        if (mayMatch(zoneMap, predicate)){
+            numCandidates += zoneMap.numRecords;
+        }
+    }
+    return numCandidates < SCAN_INDEX_MATCH_COST * estimateMatches(predicate);
+}
@@ -0,0 +1,89 @@
+#ifndef BLOCKSCAN_H
+#define BLOCKSCAN_H
+
+#include <cmath>
+#include <climits>
+#include <functional>
+#include <vector>
+
+#include "bptree.h"
+#include "bufferpool.h"
+#include "rid.h"
+#include "storage.h"
+
+using namespace std;
+
+#define SCAN_INDEX_MATCH_COST 4  // a record reached through the index costs about as much as checking 4 in a scanned block
+#define BLOCK_SCAN_BATCH_SIZE 1024  // records staged as columns before the predicate runs over them, at least RID_MAX_SLOTS
+
+// evaluate predicates 8 records at a time with AVX2 where the CPU has it
+#ifndef BLOCK_SCAN_SIMD
+#define BLOCK_SCAN_SIMD 1
+#endif
+
+// Records with numVotes and averageRating within the bounds, bounds included
+struct ScanPredicate {
+    int minVotes = INT_MIN;
+    int maxVotes = INT_MAX;
+    float minRating = -INFINITY;
+    float maxRating = INFINITY;
+};
+
+// Fields of records copied out of consecutive blocks, one array per field
+struct ScanBatch {
+    int numRecords;
+    int votes[BLOCK_SCAN_BATCH_SIZE];
+    float ratings[BLOCK_SCAN_BATCH_SIZE];
+    RID rids[BLOCK_SCAN_BATCH_SIZE];
+};
+
+// Answers predicates without the index by reading the blocks of Storage in order.
+// Records are staged a batch at a time as columns, the predicate turns a batch into a selection
+// vector of the matching positions, and aggregates run over the selection.
+// With zone maps, blocks whose bounds cannot hold a matching record are not read.
+// Not to be run beside writers of the storage
+class BlockScan {
+    private:
+        Storage *__storage;
+        bool __useZoneMaps; //skip blocks by their zone maps
+
+        //true if a block with zoneMap may hold a record matching predicate
+        static bool mayMatch(const ZoneMap &zoneMap, const ScanPredicate &predicate);
+
+        //write the positions of the records of batch matching predicate to selection, returns how many
+        static int select(const ScanBatch &batch, const ScanPredicate &predicate, int *selection);
+
+        //add the selected records of batch to result
+        static void addSelected(const ScanBatch &batch, const int *selection, int numSelected, RecordField field, Aggregate &result);
+
+        //stage blocks [firstBlock, lastBlock) in batches and pass each batch with its selection to fn,
+        //data blocks are read through bufferPool if given; returns num of blocks read
+        int scanBlocks(int firstBlock, int lastBlock, const ScanPredicate &predicate, BufferPool *bufferPool,
+                       const function<void(const ScanBatch &, const int *, int)> &fn);
+
+    public:
+        //constructor, useZoneMaps false reads every block
+        BlockScan(Storage *storage, bool useZoneMaps = true);
+
+        //aggregate field over the records matching predicate, data blocks are read through bufferPool if given;
+        //numDataBlocks counts the blocks read, numIndexNodes stays 0
+        Aggregate aggregate(const ScanPredicate &predicate, RecordField field, BufferPool *bufferPool = nullptr);
+
+        //aggregate with the blocks split into parts scanned by numThreads threads, data blocks are read from memory
+        Aggregate aggregateParallel(const ScanPredicate &predicate, RecordField field, int numThreads);
+
+        //RIDs of the records matching predicate in block order
+        vector<RID> search(const ScanPredicate &predicate);
+
+        //num of blocks the scan would read for predicate
+        int getNumCandidateBlocks(const ScanPredicate &predicate);
+
+        //records expected to match predicate, with values spread evenly between the bounds of each block
+        double estimateMatches(const ScanPredicate &predicate);
+
+        //true if checking every record of the candidate blocks is cheaper than reaching the expected
+        //matches one by one through the index
+        bool preferScan(const ScanPredicate &predicate);
+};
+
+#endif
@@ -1,37 +1,74 @@
 #include "bptree.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <fstream>
 #include <iostream>
-#include <numeric>
 #include <queue>
-#include <set>
+#include <new>
+#include <stdexcept>
+#include <thread>
 #include <unordered_map>
 
+#include "bufferpool.h"
+#include "epoch.h"
+#include "nodearena.h"
+#include "nodesearch.h"
+#include "parallel.h"
+#include "posting.h"
+#include "shared.h"
 #include "storage.h"
 
-extern void *startAddress;
-
 typedef unsigned char uchar;
 
 using namespace std;
 
-InternalNode::InternalNode(int maxKeys) {
-    keys = new int[maxKeys];
-    pointers = new Node *[maxKeys + 1];
+// A node lives in one contiguous buffer:
+// | node header | keys[maxKeys + 1] | pointers[maxKeys + 2] |
+// one spare key and pointer give a full node room to overflow before it splits.
+// Augmented trees add | recordCounts[maxKeys + 2] | ratingSums[maxKeys + 2] | for internal nodes.
+#define NODE_HEADER_SIZE ((max(sizeof(InternalNode), sizeof(LeafNode)) + 7) / 8 * 8)
+#define NODES_PER_CHUNK 1024
+#define SCAN_BATCH_SIZE 256  // RIDs handed over at a time by scanRange
+#define MULTI_SEARCH_GROUP 32  // keys multiSearch takes down the tree together
+#define MULTI_SEARCH_RADIX_MIN 512  // batches from this size are radix sorted
+#define MULTI_SEARCH_PREFETCH_BYTES 512  // bytes of a node prefetched by multiSearch
+
+static int getKeysBytes(int maxKeys) {
+    return ((maxKeys + 1) * sizeof(int) + 7) / 8 * 8;
+}
+
+static int getNodeBytes(int maxKeys, bool augmented) {
+    int totalsBytes = augmented ? (maxKeys + 2) * (sizeof(long long) + sizeof(double)) : 0;
+    return NODE_HEADER_SIZE + getKeysBytes(maxKeys) + (maxKeys + 2) * sizeof(void *) + totalsBytes;
+}
+
+InternalNode::InternalNode(int maxKeys, bool augmented) {
+    keys = (int *)((uchar *)this + NODE_HEADER_SIZE);
+    pointers = (Node **)((uchar *)keys + getKeysBytes(maxKeys));
+    recordCounts = augmented ? (long long *)(pointers + maxKeys + 2) : nullptr;
+    ratingSums = augmented ? (double *)(recordCounts + maxKeys + 2) : nullptr;
     numKeys = 0;
     isLeaf = false;
+    version = 0;
 }
 
 LeafNode::LeafNode(int maxKeys) {
-    keys = new int[maxKeys];
-    pointers = new vector<void *> *[maxKeys];
-    for (int i = 0; i < maxKeys; i++) {
-        pointers[i] = new vector<void *>();
-    }
+    keys = (int *)((uchar *)this + NODE_HEADER_SIZE);
+    pointers = (void **)((uchar *)keys + getKeysBytes(maxKeys));
     numKeys = 0;
     isLeaf = true;
     nextLeaf = nullptr;
+    version = 0;
+}
+
+InternalNode *BPTree::newInternalNode() {
+    return new (nodeArena->allocate()) InternalNode(maxKeys, augmented);
+}
+
+LeafNode *BPTree::newLeafNode() {
+    return new (nodeArena->allocate()) LeafNode(maxKeys);
 }
 
 LeafNode *BPTree::search(int key_value) {
@@ -46,114 +83,163 @@ LeafNode *BPTree::search(int key_value) {
 
         bool found = false;
 
-        // While we haven't hit a leaf node.
+        // While we haven't hit a leaf node, follow the pointer left of the
+        // first key larger than key_value (the last pointer if there is none).
         while (cursor->isLeaf == false) {
-            // Iterate through each key in the current node.
-            for (int i = 0; i < cursor->numKeys; i++) {
-                // If key_value is less than current key, go to the left
-                // pointer's node to continue searching.
-                if (key_value < cursor->keys[i]) {
-                    cursor = ((InternalNode *)cursor)->pointers[i];
-                    break;
-                }
-                // If we reached the end of all keys in this node (larger than
-                // all), then go to the right pointer's node to continue
-                // searching.
-                if (i == cursor->numKeys - 1) {
-                    cursor = ((InternalNode *)cursor)->pointers[i + 1];
-                    break;
-                }
-            }
+            int i = upperBound(cursor->keys, cursor->numKeys, key_value);
+            cursor = ((InternalNode *)cursor)->pointers[i];
         }
 
-        for (int i = 0; i < cursor->numKeys; i++) {
-            if (cursor->keys[i] == key_value) {
-                return (LeafNode *)cursor;
-            }
+        int i = lowerBound(cursor->keys, cursor->numKeys, key_value);
+        if (i < cursor->numKeys && cursor->keys[i] == key_value) {
+            return (LeafNode *)cursor;
         }
         throw std::logic_error("Not found!");
     }
 }
 
-void BPTree::insertInternal(int newKey, InternalNode *cur, Node *child) {
-    if (cur->numKeys < maxKeys) {
-        // cur not full, search for position to insert
-        int i = 0;
-        while (newKey > cur->keys[i] && i < cur->numKeys) {
-            i++;
-        }
-        // move keys and pointers to make space for new key at pos i
-        for (int j = cur->numKeys; j > i; j--) {
-            cur->keys[j] = cur->keys[j - 1];
-            cur->pointers[j + 1] = cur->pointers[j];
-        }
-        cur->keys[i] = newKey;
-        cur->numKeys++;
-        cur->pointers[i + 1] = child;
-    } else {
-        // new internal node
-        InternalNode *newInternal = new InternalNode(maxKeys);
-        numNodes++;
+// Bring the first cache lines of a node in ahead of its search
+static void prefetchNode(Node *cur, int nodeBytes) {
+    for (int offset = 0; offset < nodeBytes && offset < MULTI_SEARCH_PREFETCH_BYTES; offset += 64) {
+        __builtin_prefetch((const char *)cur + offset);
+    }
+}
 
-        // virtual node to store all values temporary
-        int vKey[maxKeys + 1];
-        Node *vPtr[maxKeys + 2];
-        // copy to vNode
-        for (int i = 0; i < maxKeys; i++) {
-            vKey[i] = cur->keys[i];
-            vPtr[i] = cur->pointers[i];
+// Descend for a group of keys together in key order: a level is searched for every key
+// of the group before any node of the next level is touched, so the misses of one level overlap.
+// Keys in the same node continue the search where the previous key stopped.
+void BPTree::multiSearch(const int *keys, int numKeys, void **slots) {
+    if (numKeys <= 0) {
+        return;
+    }
+    if (root == nullptr) {
+        fill(slots, slots + numKeys, nullptr);
+        return;
+    }
+
+    // visit keys in sorted order, order[i] is where the i-th smallest key came from
+    vector<int> order(numKeys);
+    for (int i = 0; i < numKeys; i++) {
+        order[i] = i;
+    }
+    if (!is_sorted(keys, keys + numKeys)) {
+        if (numKeys < MULTI_SEARCH_RADIX_MIN) {
+            sort(order.begin(), order.end(), [&](int a, int b) { return keys[a] < keys[b]; });
+        } else {
+            parallelRadixSort(order, [&](int i) { return (unsigned)keys[i] ^ 0x80000000u; }, 1);
         }
-        vPtr[maxKeys] = cur->pointers[maxKeys];
+    }
 
-        int i = 0;
-        int j;
-        // searching for newKey position
-        while (newKey > vKey[i] && i < maxKeys) {
-            i++;
+    int nodeBytes = nodeArena->getNodeBytes();
+    Node *nodes[MULTI_SEARCH_GROUP];
+    for (int first = 0; first < numKeys; first += MULTI_SEARCH_GROUP) {
+        int groupSize = min(MULTI_SEARCH_GROUP, numKeys - first);
+        const int *group = order.data() + first;
+        fill(nodes, nodes + groupSize, root);
+
+        while (!nodes[0]->isLeaf) {
+            Node *prevNode = nullptr;
+            Node *prevChild = nullptr;
+            int prevPos = 0;
+            for (int i = 0; i < groupSize; i++) {
+                Node *cur = nodes[i];
+                int key = keys[group[i]];
+                int pos;
+                if (cur == prevNode) {
+                    pos = prevPos + upperBound(cur->keys + prevPos, cur->numKeys - prevPos, key);
+                } else {
+                    pos = upperBound(cur->keys, cur->numKeys, key);
+                }
+                Node *child = ((InternalNode *)cur)->pointers[pos];
+                if (child != prevChild) {
+                    prefetchNode(child, nodeBytes);
+                }
+                nodes[i] = child;
+                prevNode = cur;
+                prevChild = child;
+                prevPos = pos;
+            }
         }
-        // moving keys and pointers to make space at newKey position
-        for (int j = maxKeys; j > i; j--) {
-            vKey[j] = vKey[j - 1];
-            vPtr[j + 1] = vPtr[j];
+
+        Node *prevNode = nullptr;
+        int prevPos = 0;
+        for (int i = 0; i < groupSize; i++) {
+            Node *cur = nodes[i];
+            int key = keys[group[i]];
+            int pos;
+            if (cur == prevNode) {
+                pos = prevPos + lowerBound(cur->keys + prevPos, cur->numKeys - prevPos, key);
+            } else {
+                pos = lowerBound(cur->keys, cur->numKeys, key);
+            }
+            slots[group[i]] = (pos < cur->numKeys && cur->keys[pos] == key) ? ((LeafNode *)cur)->pointers[pos] : nullptr;
+            prevNode = cur;
+            prevPos = pos;
         }
-        // insert new key and pointer
-        vKey[i] = newKey;
-        vPtr[i + 1] = child;
+    }
+}
 
-        // spilt into 2 nodes
-        cur->numKeys = (maxKeys + 1) / 2;
-        newInternal->numKeys = maxKeys - (maxKeys + 1) / 2;
+void BPTree::insertInternal(int newKey, InternalNode **path, int depth, Node *child) {
+    InternalNode *cur = path[depth];
 
-        // move keys and pointers to new nodes
-        for (i = 0; i < cur->numKeys; i++) {
-            cur->keys[i] = vKey[i];
-            cur->pointers[i] = vPtr[i];
-        }
-        cur->pointers[cur->numKeys] = vPtr[i];
+    // search for position to insert, a full node overflows into its spare key and pointer
+    int i = lowerBound(cur->keys, cur->numKeys, newKey);
+    // move keys and pointers to make space for new key at pos i
+    for (int j = cur->numKeys; j > i; j--) {
+        storeRelaxed(cur->keys[j], cur->keys[j - 1]);
+        moveChild(cur, j + 1, cur, j);
+    }
+    storeRelaxed(cur->keys[i], newKey);
+    storeRelaxed(cur->numKeys, cur->numKeys + 1);
+    storeRelease(cur->pointers[i + 1], child);
+
+    // child was split off from the child at i, move its records' totals over
+    if (augmented) {
+        long long count;
+        double ratingSum;
+        getTotals(child, count, ratingSum);
+        cur->recordCounts[i + 1] = 0;
+        cur->ratingSums[i + 1] = 0;
+        shiftTotals(cur, i, i + 1, count, ratingSum);
+    }
+    if (cur->numKeys <= maxKeys) {
+        return;
+    }
 
-        for (i = 0, j = cur->numKeys + 1; i < newInternal->numKeys; i++, j++) {
-            newInternal->keys[i] = vKey[j];
-            newInternal->pointers[i] = vPtr[j];
-        }
-        newInternal->pointers[newInternal->numKeys] = vPtr[j];
+    // new internal node
+    InternalNode *newInternal = newInternalNode();
+    numNodes++;
 
-        // cur is root node
-        if (root == cur) {
-            // new Root node
-            InternalNode *newRoot = new InternalNode(maxKeys);
-            numNodes++;
-            newRoot->pointers[0] = cur;
-            newRoot->pointers[1] = newInternal;
-            int smallKey = getSmallestKey(newInternal);
-            newRoot->keys[0] = smallKey;
-            newRoot->isLeaf = false;
-            newRoot->numKeys = 1;
-            root = newRoot;
-        } else {
-            // recursive call
-            insertInternal(getSmallestKey(newInternal),
-                           (InternalNode *)findParent(root, cur), newInternal);
+    // spilt into 2 nodes, the key between them moves up
+    int leftKeys = (maxKeys + 1) / 2;
+    newInternal->numKeys = maxKeys - leftKeys;
+    for (i = 0; i < newInternal->numKeys; i++) {
+        newInternal->keys[i] = cur->keys[leftKeys + 1 + i];
+    }
+    for (i = 0; i <= newInternal->numKeys; i++) {
+        moveChild(newInternal, i, cur, leftKeys + 1 + i);
+    }
+    storeRelaxed(cur->numKeys, leftKeys);
+
+    // cur is root node
+    if (root == cur) {
+        // new Root node
+        InternalNode *newRoot = newInternalNode();
+        numNodes++;
+        newRoot->pointers[0] = cur;
+        newRoot->pointers[1] = newInternal;
+        int smallKey = getSmallestKey(newInternal);
+        newRoot->keys[0] = smallKey;
+        newRoot->isLeaf = false;
+        newRoot->numKeys = 1;
+        if (augmented) {
+            getTotals(cur, newRoot->recordCounts[0], newRoot->ratingSums[0]);
+            getTotals(newInternal, newRoot->recordCounts[1], newRoot->ratingSums[1]);
         }
+        storeRelease(root, (Node *)newRoot);
+    } else {
+        // recursive call, parent is the node above cur on the path
+        insertInternal(getSmallestKey(newInternal), path, depth - 1, newInternal);
     }
 }
 
@@ -164,369 +250,341 @@ int BPTree::getSmallestKey(Node *cur) {
     return cur->keys[0];
 }
 
-int BPTree::removeInternal(int targetKey, Node *parent, void *child) {
-    int numDeletions = 0;
-    int pos;
-
-    for (pos = 0; pos < parent->numKeys; pos++) {
-        if (parent->keys[pos] >= targetKey) {
-            break;
+// Fix an internal node on the path that fell below the minimum number of keys
+// by borrowing from or merging with a sibling, returns num of nodes deleted
+int BPTree::removeInternal(InternalNode **path, int *childPos, int depth) {
+    InternalNode *cur = path[depth];
+    int minKeys = (maxKeys + 2) / 2 - 1;
+
+    // root only needs one child, an empty root hands over to its child
+    if (depth == 0) {
+        if (cur->numKeys == 0) {
+            storeRelease(root, cur->pointers[0]);
+            releaseNode(cur);
+            numNodes--;
+            return 1;
         }
+        return 0;
     }
-    for (int i = pos; i < parent->numKeys - 1; i++) {
-        parent->keys[i] = parent->keys[i + 1];
+    if (cur->numKeys >= minKeys) {
+        return 0;
     }
 
-    for (pos = 0; pos < parent->numKeys + 1; pos++) {
-        if (((InternalNode *)parent)->pointers[pos] == child) {
-            break;
+    InternalNode *parent = path[depth - 1];
+    int pos = childPos[depth - 1];
+    InternalNode *leftNode = (pos > 0) ? (InternalNode *)parent->pointers[pos - 1] : nullptr;
+    InternalNode *rightNode = (pos < parent->numKeys) ? (InternalNode *)parent->pointers[pos + 1] : nullptr;
+
+    // Sharing keys/pointers, parent key rotates through
+    if (leftNode != nullptr && leftNode->numKeys > minKeys) {
+        for (int i = cur->numKeys; i > 0; i--) {
+            storeRelaxed(cur->keys[i], cur->keys[i - 1]);
+        }
+        for (int i = cur->numKeys + 1; i > 0; i--) {
+            moveChild(cur, i, cur, i - 1);
         }
+        storeRelaxed(cur->keys[0], parent->keys[pos - 1]);
+        moveChild(cur, 0, leftNode, leftNode->numKeys);
+        storeRelaxed(parent->keys[pos - 1], leftNode->keys[leftNode->numKeys - 1]);
+        if (augmented) {
+            shiftTotals(parent, pos - 1, pos, cur->recordCounts[0], cur->ratingSums[0]);
+        }
+        storeRelaxed(cur->numKeys, cur->numKeys + 1);
+        storeRelaxed(leftNode->numKeys, leftNode->numKeys - 1);
+        return 0;
     }
-    for (int i = pos; i < parent->numKeys + 1; i++) {
-        if (parent->isLeaf) {
-            ((LeafNode *)parent)->pointers[i] =
-                ((LeafNode *)parent)->pointers[i + 1];
-        } else {
-            ((InternalNode *)parent)->pointers[i] =
-                ((InternalNode *)parent)->pointers[i + 1];
+    if (rightNode != nullptr && rightNode->numKeys > minKeys) {
+        storeRelaxed(cur->keys[cur->numKeys], parent->keys[pos]);
+        moveChild(cur, cur->numKeys + 1, rightNode, 0);
+        storeRelaxed(parent->keys[pos], rightNode->keys[0]);
+        if (augmented) {
+            shiftTotals(parent, pos + 1, pos, rightNode->recordCounts[0], rightNode->ratingSums[0]);
         }
+        for (int i = 0; i < rightNode->numKeys - 1; i++) {
+            storeRelaxed(rightNode->keys[i], rightNode->keys[i + 1]);
+        }
+        for (int i = 0; i < rightNode->numKeys; i++) {
+            moveChild(rightNode, i, rightNode, i + 1);
+        }
+        storeRelaxed(cur->numKeys, cur->numKeys + 1);
+        storeRelaxed(rightNode->numKeys, rightNode->numKeys - 1);
+        return 0;
     }
 
-    parent->numKeys--;
+    // Merge nodes, the right one of the pair goes into the left one with the parent key between them
+    InternalNode *left = (leftNode != nullptr) ? leftNode : cur;
+    InternalNode *right = (leftNode != nullptr) ? cur : rightNode;
+    int sepPos = (leftNode != nullptr) ? pos - 1 : pos;
 
-    // If minimum number of keys/pointers met, can just return
-    if (parent == root) return numDeletions;
-    if ((parent->isLeaf && parent->numKeys >= (maxKeys + 1) / 2) ||
-        (!parent->isLeaf && parent->numKeys >= (maxKeys + 2) / 2 - 1)) {
-        return numDeletions;
+    storeRelaxed(left->keys[left->numKeys], parent->keys[sepPos]);
+    for (int i = 0; i < right->numKeys; i++) {
+        storeRelaxed(left->keys[left->numKeys + 1 + i], right->keys[i]);
     }
-
-    // Else, we need to recursively update the tree
-    InternalNode *parentPtr = (InternalNode *)findParentInclLeaf(root, parent);
-    int leftPos, rightPos;
-    for (int pos = 0; pos < parentPtr->numKeys + 1; pos++) {
-        if (parentPtr->pointers[pos] == parent) {
-            leftPos = pos - 1;
-            rightPos = pos + 1;
-            break;
-        }
+    for (int i = 0; i <= right->numKeys; i++) {
+        moveChild(left, left->numKeys + 1 + i, right, i);
     }
+    storeRelaxed(left->numKeys, left->numKeys + right->numKeys + 1);
 
-    // Sharing keys/pointers
-    if (leftPos >= 0) {
-        Node *leftNode = parentPtr->pointers[leftPos];
-        if ((leftNode->isLeaf && leftNode->numKeys > (maxKeys + 1) / 2) ||
-            (!leftNode->isLeaf && leftNode->numKeys > (maxKeys + 2) / 2 - 1)) {
-            for (int i = parent->numKeys; i > 0; i--) {
-                parent->keys[i] = parent->keys[i - 1];
-            }
-            parent->keys[0] = leftNode->keys[leftNode->numKeys - 1];
-            parentPtr->keys[leftPos] = leftNode->keys[leftNode->numKeys - 1];
-
-            for (int i = parent->numKeys + 1; i > 0; i--) {
-                if (parent->isLeaf) {
-                    ((LeafNode *)parent)->pointers[i] =
-                        ((LeafNode *)parent)->pointers[i - 1];
-                } else {
-                    ((InternalNode *)parent)->pointers[i] =
-                        ((InternalNode *)parent)->pointers[i - 1];
-                }
-            }
-            if (parent->isLeaf) {
-                ((LeafNode *)parent)->pointers[0] =
-                    ((LeafNode *)leftNode)->pointers[leftNode->numKeys];
-            } else {
-                ((InternalNode *)parent)->pointers[0] =
-                    ((InternalNode *)leftNode)->pointers[leftNode->numKeys];
-            }
-
-            parent->numKeys++;
-            leftNode->numKeys--;
-            return numDeletions;
-        }
+    if (augmented) {
+        shiftTotals(parent, sepPos + 1, sepPos, parent->recordCounts[sepPos + 1], parent->ratingSums[sepPos + 1]);
     }
-    if (rightPos <= parentPtr->numKeys) {
-        Node *rightNode = parentPtr->pointers[rightPos];
-        if ((rightNode->isLeaf && rightNode->numKeys > (maxKeys + 1) / 2) ||
-            (!rightNode->isLeaf &&
-             rightNode->numKeys > (maxKeys + 2) / 2 - 1)) {
-            parent->keys[parent->numKeys] = rightNode->keys[0];
-            for (int i = 0; i < rightNode->numKeys - 1; i++) {
-                rightNode->keys[i] = rightNode->keys[i + 1];
-            }
-            parentPtr->keys[rightPos - 1] = rightNode->keys[0];
+    removeChild(parent, sepPos);
+    releaseNode(right);
+    numNodes--;
 
-            if (parent->isLeaf) {
-                ((LeafNode *)parent)->pointers[parent->numKeys + 1] =
-                    ((LeafNode *)rightNode)->pointers[0];
-            } else {
-                ((InternalNode *)parent)->pointers[parent->numKeys + 1] =
-                    ((InternalNode *)rightNode)->pointers[0];
-            }
-            for (int i = 0; i < rightNode->numKeys; ++i) {
-                if (rightNode->isLeaf) {
-                    ((LeafNode *)rightNode)->pointers[i] =
-                        ((LeafNode *)rightNode)->pointers[i + 1];
-                } else {
-                    ((InternalNode *)rightNode)->pointers[i] =
-                        ((InternalNode *)rightNode)->pointers[i + 1];
-                }
-            }
+    return 1 + removeInternal(path, childPos, depth - 1);
+}
 
-            parent->numKeys++;
-            rightNode->numKeys--;
-            return numDeletions;
-        }
+// Remove key at keyPos and the pointer right of it from an internal node
+void BPTree::removeChild(InternalNode *cur, int keyPos) {
+    for (int i = keyPos; i < cur->numKeys - 1; i++) {
+        storeRelaxed(cur->keys[i], cur->keys[i + 1]);
     }
+    for (int i = keyPos + 1; i < cur->numKeys; i++) {
+        moveChild(cur, i, cur, i + 1);
+    }
+    storeRelaxed(cur->numKeys, cur->numKeys - 1);
+}
 
-    // Merge nodes
-    if (leftPos >= 0) {
-        Node *leftNode = parentPtr->pointers[leftPos];
-        if (!leftNode->isLeaf) {
-            leftNode->keys[leftNode->numKeys] = parentPtr->keys[leftPos];
-
-            for (int i = leftNode->numKeys + 1, j = 0; j < parent->numKeys;
-                 i++, j++) {
-                leftNode->keys[i] = parent->keys[j];
-            }
-
-            for (int i = leftNode->numKeys + 1, j = 0; j <= parent->numKeys;
-                 i++, j++) {
-                if ((parent->isLeaf &&
-                     ((LeafNode *)parent)->pointers[j] == child) ||
-                    (!parent->isLeaf &&
-                     ((InternalNode *)parent)->pointers[j] == child)) {
-                    i--;
-                    continue;
-                }
-                if (leftNode->isLeaf) {
-                    ((LeafNode *)leftNode)->pointers[i] =
-                        ((LeafNode *)parent)->pointers[j];
-                    ((LeafNode *)parent)->pointers[j] = NULL;
-                } else {
-                    ((InternalNode *)leftNode)->pointers[i] =
-                        ((InternalNode *)parent)->pointers[j];
-                    ((InternalNode *)parent)->pointers[j] = NULL;
-                }
-            }
-
-            leftNode->numKeys += parent->numKeys + 1;
-        } else {
-            for (int i = leftNode->numKeys, j = 0; j < parent->numKeys;
-                 i++, j++) {
-                leftNode->keys[i] = parent->keys[j];
-            }
-
-            for (int i = leftNode->numKeys + 1, j = 0; j < parent->numKeys + 1;
-                 i++, j++) {
-                if (leftNode->isLeaf) {
-                    ((LeafNode *)leftNode)->pointers[i] =
-                        ((LeafNode *)parent)->pointers[j];
-                    ((LeafNode *)parent)->pointers[j] = NULL;
-                } else {
-                    ((InternalNode *)leftNode)->pointers[i] =
-                        ((InternalNode *)parent)->pointers[j];
-                    ((InternalNode *)parent)->pointers[j] = NULL;
-                }
-            }
+void BPTree::moveChild(InternalNode *to, int toPos, InternalNode *from, int fromPos) {
+    storeRelease(to->pointers[toPos], from->pointers[fromPos]);
+    if (augmented) {
+        to->recordCounts[toPos] = from->recordCounts[fromPos];
+        to->ratingSums[toPos] = from->ratingSums[fromPos];
+    }
+}
 
-            leftNode->numKeys += parent->numKeys;
+void BPTree::getTotals(Node *cur, long long &count, double &ratingSum) {
+    count = 0;
+    ratingSum = 0;
+    if (cur->isLeaf) {
+        for (int i = 0; i < cur->numKeys; i++) {
+            long long keyCount;
+            double keySum;
+            getTotals(((LeafNode *)cur)->pointers[i], keyCount, keySum);
+            count += keyCount;
+            ratingSum += keySum;
         }
-        parent->numKeys = 0;
-
-        numDeletions +=
-            1 + removeInternal(parentPtr->keys[leftPos], parentPtr, parent);
-    } else if (rightPos <= parentPtr->numKeys) {
-        Node *rightNode = parentPtr->pointers[rightPos];
-        if (!rightNode->isLeaf) {
-            parent->keys[parent->numKeys] = parentPtr->keys[rightPos - 1];
-
-            for (int i = parent->numKeys + 1, j = 0; j < rightNode->numKeys;
-                 i++, j++) {
-                parent->keys[i] = rightNode->keys[j];
-            }
+        return;
+    }
+    for (int i = 0; i <= cur->numKeys; i++) {
+        count += ((InternalNode *)cur)->recordCounts[i];
+        ratingSum += ((InternalNode *)cur)->ratingSums[i];
+    }
+}
 
-            for (int i = parent->numKeys + 1, j = 0; j < rightNode->numKeys;
-                 i++, j++) {
-                if ((rightNode->isLeaf &&
-                     ((LeafNode *)rightNode)->pointers[j] == child) ||
-                    (!rightNode->isLeaf &&
-                     ((InternalNode *)rightNode)->pointers[j] == child)) {
-                    i--;
-                    continue;
-                }
-                if (rightNode->isLeaf) {
-                    ((LeafNode *)parent)->pointers[i] =
-                        ((LeafNode *)rightNode)->pointers[j];
-                    ((LeafNode *)rightNode)->pointers[j] = NULL;
-                } else {
-                    ((InternalNode *)parent)->pointers[i] =
-                        ((InternalNode *)rightNode)->pointers[j];
-                    ((InternalNode *)rightNode)->pointers[j] = NULL;
-                }
-            }
+void BPTree::getTotals(void *slot, long long &count, double &ratingSum) {
+    count = 0;
+    ratingSum = 0;
+    PostingList::forEach(slot, [&](RID rid) {
+        count++;
+        ratingSum += storage->getAverageRating(rid);
+    });
+}
 
-            parent->numKeys += rightNode->numKeys + 1;
-        } else {
-            for (int i = parent->numKeys, j = 0; j < rightNode->numKeys;
-                 i++, j++) {
-                parent->keys[i] = rightNode->keys[j];
-            }
+void BPTree::addToPath(InternalNode **path, int *childPos, int depth, long long count, double ratingSum) {
+    for (int d = 0; d < depth; d++) {
+        path[d]->recordCounts[childPos[d]] += count;
+        path[d]->ratingSums[childPos[d]] += ratingSum;
+    }
+}
 
-            for (int i = parent->numKeys + 1, j = 0; j < rightNode->numKeys + 1;
-                 i++, j++) {
-                if (rightNode->isLeaf) {
-                    ((LeafNode *)parent)->pointers[i] =
-                        ((LeafNode *)rightNode)->pointers[j];
-                    ((LeafNode *)rightNode)->pointers[j] = NULL;
-                } else {
-                    ((InternalNode *)parent)->pointers[i] =
-                        ((InternalNode *)rightNode)->pointers[j];
-                    ((InternalNode *)rightNode)->pointers[j] = NULL;
-                }
-            }
+void BPTree::shiftTotals(InternalNode *cur, int fromPos, int toPos, long long count, double ratingSum) {
+    cur->recordCounts[fromPos] -= count;
+    cur->ratingSums[fromPos] -= ratingSum;
+    cur->recordCounts[toPos] += count;
+    cur->ratingSums[toPos] += ratingSum;
+}
 
-            parent->numKeys += rightNode->numKeys;
-        }
-        rightNode->numKeys = 0;
+void BPTree::beginWrite(Node *leaf, bool structural) {
+    if (!concurrent) {
+        return;
+    }
+    if (structural) {
+        treeVersion.fetch_add(1);
+        writingStructure = true;
+    } else {
+        leaf->version.fetch_add(1);
+        writingLeaf = leaf;
+    }
+}
 
-        numDeletions += 1 + removeInternal(parentPtr->keys[rightPos - 1],
-                                           parentPtr, rightNode);
+void BPTree::endWrite() {
+    if (writingStructure) {
+        treeVersion.fetch_add(1, memory_order_release);
+        writingStructure = false;
+    }
+    if (writingLeaf != nullptr) {
+        writingLeaf->version.fetch_add(1, memory_order_release);
+        writingLeaf = nullptr;
     }
-    return numDeletions;
+    epochs->reclaim();
 }
 
-InternalNode *BPTree::findParent(Node *cur, Node *child) {
-    Node *parent;
+void BPTree::releaseNode(Node *cur) {
+    if (concurrent) {
+        epochs->retire([this, cur]() { nodeArena->release(cur); });
+        return;
+    }
+    nodeArena->release(cur);
+}
 
-    // end of tree
-    if (cur->isLeaf || (((InternalNode *)cur)->pointers[0])->isLeaf) {
-        return NULL;
+void BPTree::deleteRecords(void *slot) {
+    if (storage->getBlockFormat() == SLOTTED_BLOCKS) {
+        deleteRecords(PostingList::getAddresses(slot));
     }
+}
 
-    for (int i = 0; i < cur->numKeys + 1; i++) {
-        if (((InternalNode *)cur)->pointers[i] == child) {
-            parent = cur;
-            return (InternalNode *)parent;
-        } else {
-            parent = findParent(((InternalNode *)cur)->pointers[i], child);
-            if (parent != NULL) {
-                return (InternalNode *)parent;
+void BPTree::deleteRecords(const vector<RID> &rids) {
+    if (concurrent) {
+        epochs->retire([this, rids]() {
+            for (RID rid : rids) {
+                storage->deleteRecord(rid);
             }
-        }
+        });
+        return;
+    }
+    for (RID rid : rids) {
+        storage->deleteRecord(rid);
     }
-    return (InternalNode *)parent;
 }
 
-Node *BPTree::findParentInclLeaf(Node *cur, Node *child) {
-    Node *parent;
-
-    // end of tree
-    if (cur->isLeaf) {
-        return NULL;
+void BPTree::releasePosting(void *slot) {
+    if (concurrent) {
+        epochs->retire([slot]() { PostingList::release(slot); });
+        return;
     }
+    PostingList::release(slot);
+}
 
-    // cur is InternalNode
-    for (int i = 0; i < cur->numKeys + 1; i++) {
-        if (((InternalNode *)cur)->pointers[i] == child) {
-            parent = cur;
-            return parent;
-        } else {
-            parent =
-                findParentInclLeaf(((InternalNode *)cur)->pointers[i], child);
-            if (parent != NULL) {
-                return parent;
-            }
-        }
+// Descend to the leaf for key_value, recording the internal nodes and the
+// child position taken in each, returns the depth of the leaf
+int BPTree::findPath(int key_value, InternalNode **path, int *childPos) {
+    Node *cur = root;
+    int depth = 0;
+    while (!cur->isLeaf) {
+        int i = upperBound(cur->keys, cur->numKeys, key_value);
+        path[depth] = (InternalNode *)cur;
+        childPos[depth] = i;
+        depth++;
+        cur = ((InternalNode *)cur)->pointers[i];
     }
-    return parent;
+    path[depth] = (InternalNode *)cur;
+    return depth;
 }
 
-BPTree::BPTree(int blockCapacity) {
+BPTree::BPTree(Storage *storage, bool augmented, bool concurrent) {
     root = nullptr;
+    this->storage = storage;
+    this->augmented = augmented;
+    this->concurrent = concurrent;
+    treeVersion = 0;
+    writingLeaf = nullptr;
+    writingStructure = false;
+    epochs = concurrent ? new EpochManager() : nullptr;
     height = 0;
+    numNodes = 0;
     nodeSize = 0;
-    __blockCapacity = blockCapacity;
+    __blockCapacity = storage->getBlockCapacity();
 
     // calculate max size of a node
     // cout << "size of node* = " << sizeof(Node*) << endl;
     // cout << "size of KEY = " << sizeof(Key) << endl;
     maxKeys = floor((__blockCapacity - sizeof(Node *)) /
-                    (sizeof(vector<void *> *) + sizeof(int)));
+                    (sizeof(void *) + sizeof(int)));
+
+    // nodes take at least a whole block so they could be stored as blocks
+    nodeArena = new NodeArena(max(__blockCapacity, getNodeBytes(maxKeys, augmented)), NODES_PER_CHUNK);
+}
+
+BPTree::~BPTree() {
+    // run the frees held back for readers first
+    delete epochs;
+
+    // free the posting lists along the leaf chain, nodes go with the arena
+    if (root != nullptr) {
+        Node *cur = root;
+        while (!cur->isLeaf) {
+            cur = ((InternalNode *)cur)->pointers[0];
+        }
+        for (LeafNode *leaf = (LeafNode *)cur; leaf != nullptr; leaf = (LeafNode *)leaf->nextLeaf) {
+            for (int i = 0; i < leaf->numKeys; i++) {
+                PostingList::release(leaf->pointers[i]);
+            }
+        }
+    }
+    delete nodeArena;
 }
 
-// insert new Key
+// insert new Key, one writer at a time in a concurrent tree
 void BPTree::insert(Key newKey) {
+    if (!concurrent) {
+        insertKey(newKey);
+        return;
+    }
+    lock_guard<mutex> writer(writerLock);
+    insertKey(newKey);
+    endWrite();
+}
+
+void BPTree::insertKey(Key newKey) {
     // first key
     if (root == nullptr) {
-        root = new LeafNode(maxKeys);
-        root->keys[0] = newKey.key_value;
-        ((LeafNode *)root)->pointers[0]->push_back(newKey.address[0]);
-        root->numKeys = 1;
+        beginWrite(nullptr, true);
+        LeafNode *leaf = newLeafNode();
+        leaf->keys[0] = newKey.key_value;
+        leaf->pointers[0] = PostingList::add(nullptr, newKey.address[0]);
+        leaf->numKeys = 1;
+        storeRelease(root, (Node *)leaf);
         numNodes++;
         return;
     } else {
-        Node *cur = root;
-        InternalNode *parent;
-
-        // traverse till leaf node
-        while (!cur->isLeaf) {
-            parent = (InternalNode *)cur;
-
-            if (newKey.key_value >= cur->keys[cur->numKeys - 1]) {
-                cur = ((InternalNode *)cur)->pointers[cur->numKeys];
-            } else {
-                int i = 0;
-                while (newKey.key_value >= cur->keys[i]) {
-                    i++;
-                }
-                cur = ((InternalNode *)cur)->pointers[i];
-            }
+        // traverse till leaf node, remembering the internal nodes passed
+        InternalNode *path[MAX_HEIGHT];
+        int childPos[MAX_HEIGHT];
+        int depth = findPath(newKey.key_value, path, childPos);
+        Node *cur = (Node *)path[depth];
+
+        // currently at leaf node, find position for newKey
+        int pos = lowerBound(cur->keys, cur->numKeys, newKey.key_value);
+        bool found = pos < cur->numKeys && cur->keys[pos] == newKey.key_value;
+
+        // only a split changes more than this leaf
+        beginWrite(cur, augmented || (!found && cur->numKeys >= maxKeys));
+        if (augmented) {
+            addToPath(path, childPos, depth, 1, storage->getAverageRating(newKey.address[0]));
         }
 
-        // currently at leaf node
         // if key_value is already in the B+ tree
-        for (int i = 0; i < cur->numKeys; i++) {
-            if (cur->keys[i] == newKey.key_value) {
-                ((LeafNode *)cur)->pointers[i]->push_back(newKey.address[0]);
-                return;
-            }
+        if (found) {
+            storeRelease(((LeafNode *)cur)->pointers[pos], PostingList::add(((LeafNode *)cur)->pointers[pos], newKey.address[0]));
+            return;
         }
 
         // if key_value is not yet in the B+ tree
         if (cur->numKeys < maxKeys) {  // Node is not full
-            int i = 0;
-
-            if (newKey.key_value > cur->keys[cur->numKeys - 1]) {
-                i = cur->numKeys;
-            }
-
-            // find position for newKey
-            while (newKey.key_value > cur->keys[i] && i < cur->numKeys) {
-                i++;
-            }
+            int i = pos;
 
             // shifting of keys and pointers
             for (int j = cur->numKeys; j > i; j--) {
-                cur->keys[j] = cur->keys[j - 1];
-                ((LeafNode *)cur)->pointers[j] =
-                    ((LeafNode *)cur)->pointers[j - 1];
+                storeRelaxed(cur->keys[j], cur->keys[j - 1]);
+                storeRelease(((LeafNode *)cur)->pointers[j],
+                    ((LeafNode *)cur)->pointers[j - 1]);
             }
 
             // inserting newKey
-            cur->keys[i] = newKey.key_value;
-            cur->numKeys++;
+            storeRelaxed(cur->keys[i], newKey.key_value);
+            storeRelaxed(cur->numKeys, cur->numKeys + 1);
 
 
-            ((LeafNode *)cur)->pointers[i] = new vector<void *>();
-            ((LeafNode *)cur)->pointers[i]->push_back(newKey.address[0]);
+            storeRelease(((LeafNode *)cur)->pointers[i], PostingList::add(nullptr, newKey.address[0]));
             return;
 
         } 
         else {  // need to create new Node
-            LeafNode *newLeaf = new LeafNode(maxKeys);
+            LeafNode *newLeaf = newLeafNode();
             int vNode[maxKeys + 1];
-            vector<void *> *vPtr[maxKeys + 1];
+            void *vPtr[maxKeys + 1];
 
             for (int i = 0; i < maxKeys; i++) {
                 vNode[i] = cur->keys[i];
@@ -535,15 +593,11 @@ void BPTree::insert(Key newKey) {
 
             if (newKey.key_value > vNode[maxKeys - 1]) {
                 vNode[maxKeys] = newKey.key_value;
-                vPtr[maxKeys] = new vector<void *>();
-                vPtr[maxKeys]->push_back(newKey.address[0]);
+                vPtr[maxKeys] = PostingList::add(nullptr, newKey.address[0]);
                 numNodes++;
             } 
             else {
-                int i = 0;
-                while (newKey.key_value > vNode[i]) {
-                    i++;
-                }
+                int i = pos;
                 numNodes++;
 
                 // shifting of keys in vNode
@@ -554,31 +608,31 @@ void BPTree::insert(Key newKey) {
 
                 // insert into vNode
                 vNode[i] = newKey.key_value;
-                vPtr[i] = new vector<void *>();
-                vPtr[i]->push_back(newKey.address[0]);
+                vPtr[i] = PostingList::add(nullptr, newKey.address[0]);
             }
-            cur->numKeys = (maxKeys + 1) / 2;
-            newLeaf->numKeys = maxKeys + 1 - (maxKeys + 1) / 2;
-
-            newLeaf->nextLeaf = ((LeafNode *)cur)->nextLeaf;
-            ((LeafNode *)cur)->nextLeaf = newLeaf;
+            int leftKeys = (maxKeys + 1) / 2;
+            newLeaf->numKeys = maxKeys + 1 - leftKeys;
 
-            // moving keys from vNode back to cur and newLeaf
+            // moving keys from vNode back to cur and newLeaf, newLeaf is filled before it is linked
             int i;
-            for (i = 0; i < cur->numKeys; i++) {
-                cur->keys[i] = vNode[i];
-                ((LeafNode *)cur)->pointers[i] = vPtr[i];
+            for (i = 0; i < leftKeys; i++) {
+                storeRelaxed(cur->keys[i], vNode[i]);
+                storeRelease(((LeafNode *)cur)->pointers[i], vPtr[i]);
             }
+            storeRelaxed(cur->numKeys, leftKeys);
 
             for (int j = 0; j < newLeaf->numKeys; i++, j++) {
                 newLeaf->keys[j] = vNode[i];
                 ((LeafNode *)newLeaf)->pointers[j] = vPtr[i];
             }
 
+            newLeaf->nextLeaf = ((LeafNode *)cur)->nextLeaf;
+            storeRelease(((LeafNode *)cur)->nextLeaf, (Node *)newLeaf);
+
             // updating parent node
             if (cur == root) {
                 // create new root node
-                InternalNode *newRoot = new InternalNode(maxKeys);
+                InternalNode *newRoot = newInternalNode();
                 numNodes++;
 
                 newRoot->keys[0] = newLeaf->keys[0];
@@ -586,247 +640,990 @@ void BPTree::insert(Key newKey) {
                 newRoot->pointers[1] = newLeaf;
                 newRoot->isLeaf = false;
                 newRoot->numKeys = 1;
-                root = newRoot;
+                if (augmented) {
+                    getTotals(cur, newRoot->recordCounts[0], newRoot->ratingSums[0]);
+                    getTotals(newLeaf, newRoot->recordCounts[1], newRoot->ratingSums[1]);
+                }
+                storeRelease(root, (Node *)newRoot);
             } 
             else {
                 // insert in parent Node
-                insertInternal(newLeaf->keys[0], parent, newLeaf);
+                insertInternal(newLeaf->keys[0], path, depth - 1, newLeaf);
             }
         }
     }
 }
 
-tuple<int, int, float> BPTree::searchExp(int lowerBoundKey, int upperBoundKey, string filename) {
-    int numIndexBlockAccessed = 0;
-    float averageRating = 0;
-    tuple<int, int, float> results;
-    vector<float> allRatings;
-    fill(allRatings.begin(), allRatings.end(), 0.0);  // need to make sure this is cleared before starting next experiment 4
-    std::ofstream fout(filename + ".txt");
-    set<int> blockSet;
-    int numInternal = 0;
-    int numLeaf = 0;
-    int numRecords = 0;
+int BPTree::moveRecords(vector<RecordMove> &moves) {
+    sort(moves.begin(), moves.end(), [](const RecordMove &a, const RecordMove &b) {
+        return (a.key != b.key) ? a.key < b.key : a.from < b.from;
+    });
+    unique_lock<mutex> writer(writerLock, defer_lock);
+    if (concurrent) {
+        writer.lock();
+    }
 
-    // If tree is not empty
-    if (root != nullptr) {
-        Node *cursor = root;  // the variable cursor will hold address of root
+    vector<RID> moved, orphans, from, to;
+    vector<uchar> replaced;
+    LeafNode *leaf = nullptr;
+    size_t i = 0;
+    while (i < moves.size()) {
+        size_t end = i;
+        while (end < moves.size() && moves[end].key == moves[i].key) {
+            end++;
+        }
+        int key = moves[i].key;
 
-        // To begin search starting from internal nodes i.e not leaf nodes
-        while (cursor->isLeaf == false) {
+        // keys are sorted, the next leaf is only looked up once a key is past the current one
+        if (root != nullptr && (leaf == nullptr || key > leaf->keys[leaf->numKeys - 1])) {
+            if (leaf != nullptr && concurrent) {
+                endWrite();
+            }
+            InternalNode *path[MAX_HEIGHT];
+            int childPos[MAX_HEIGHT];
+            leaf = (LeafNode *)path[findPath(key, path, childPos)];
+            beginWrite(leaf, false);
+        }
 
-            // Search through the keys in current node
-            for (int i = 0; i < cursor->numKeys; i++) {
-                
-                // If key is greater than lowerBound provided, proceed to left subtree & continue the search
-                if (lowerBoundKey < cursor->keys[i]) {
+        from.clear();
+        to.clear();
+        for (size_t j = i; j < end; j++) {
+            from.push_back(moves[j].from);
+            to.push_back(moves[j].to);
+        }
+        replaced.assign(end - i, 0);
+        int pos = (leaf != nullptr) ? lowerBound(leaf->keys, leaf->numKeys, key) : 0;
+        if (leaf != nullptr && pos < leaf->numKeys && leaf->keys[pos] == key) {
+            void *slot = leaf->pointers[pos];
+            void *newSlot = PostingList::replace(slot, from.data(), to.data(), from.size(), replaced.data());
+            if (newSlot != slot) {
+                storeRelease(leaf->pointers[pos], newSlot);
+                releasePosting(slot);
+            }
+        }
+        for (size_t j = 0; j < from.size(); j++) {
+            if (replaced[j]) {
+                moved.push_back(from[j]);
+            } else {
+                orphans.push_back(to[j]);
+            }
+        }
+        i = end;
+    }
+    if (leaf != nullptr && concurrent) {
+        endWrite();
+    }
 
-                    // std::cout << "Index node (Internal Node) successfully accessed in process. This is the content: ---- |";
-                    fout << "Index node (Internal Node) successfully accessed in process. This is the content: ---- |";
-                    for (int x = 0; x < cursor->numKeys; x++) {
+    // readers may still hold the RIDs of the originals, nobody has seen the orphaned copies
+    deleteRecords(moved);
+    for (RID rid : orphans) {
+        storage->deleteRecord(rid);
+    }
+    return moved.size();
+}
 
-                        // cout << cursor->keys[x] << "|";
-                        fout << cursor->keys[x] << "|" ;
-                
-                    }
-                    fout << "\n";
-                    // cout <<"\n";
-                    cursor = ((InternalNode *)cursor)->pointers[i];
+void BPTree::cluster() {
+    if (root == nullptr) {
+        return;
+    }
+    Node *cur = root;
+    while (!cur->isLeaf) {
+        cur = ((InternalNode *)cur)->pointers[0];
+    }
+    LeafNode *firstLeaf = (LeafNode *)cur;
+
+    // the leaf chain gives the records in key order
+    vector<RID> rids;
+    rids.reserve(storage->getNumRecords());
+    for (LeafNode *leaf = firstLeaf; leaf != nullptr; leaf = (LeafNode *)leaf->nextLeaf) {
+        for (int i = 0; i < leaf->numKeys; i++) {
+            PostingList::forEach(leaf->pointers[i], [&](RID rid) { rids.push_back(rid); });
+        }
+    }
+    storage->rewriteRecords(rids);
+
+    // every key gets the next run of new RIDs, counts and sums stay the same
+    size_t next = 0;
+    for (LeafNode *leaf = firstLeaf; leaf != nullptr; leaf = (LeafNode *)leaf->nextLeaf) {
+        for (int i = 0; i < leaf->numKeys; i++) {
+            int numRIDs = PostingList::count(leaf->pointers[i]);
+            void *slot = nullptr;
+            for (int j = 0; j < numRIDs; j++) {
+                slot = PostingList::add(slot, rids[next++]);
+            }
+            PostingList::release(leaf->pointers[i]);
+            leaf->pointers[i] = slot;
+        }
+    }
+}
 
-                    numIndexBlockAccessed++;
-                    numInternal++;
+void BPTree::compress() {
+    if (root == nullptr) {
+        return;
+    }
+    vector<RID> oldRIDs;
+    oldRIDs.reserve(storage->getNumRecords());
+    storage->getRIDs(oldRIDs);
+    vector<RID> newRIDs = oldRIDs;
+    storage->rewriteRecords(newRIDs);
+
+    // RIDs in block order only grow, the new RID of a record is found by its place among the old ones
+    Node *cur = root;
+    while (!cur->isLeaf) {
+        cur = ((InternalNode *)cur)->pointers[0];
+    }
+    for (LeafNode *leaf = (LeafNode *)cur; leaf != nullptr; leaf = (LeafNode *)leaf->nextLeaf) {
+        for (int i = 0; i < leaf->numKeys; i++) {
+            void *slot = nullptr;
+            PostingList::forEach(leaf->pointers[i], [&](RID rid) {
+                slot = PostingList::add(slot, newRIDs[lower_bound(oldRIDs.begin(), oldRIDs.end(), rid) - oldRIDs.begin()]);
+            });
+            PostingList::release(leaf->pointers[i]);
+            leaf->pointers[i] = slot;
+        }
+    }
+}
 
-                    break;
-                }
-                // If last key in node is reached (all keys in this node smaller than lowerBound), proceed to right subtree & continue the search
-                if (i == (cursor->numKeys) - 1) {
+// split numEntries into nodes holding about fillFactor * maxEntries entries,
+// spread evenly so that no node falls below minEntries
+static vector<int> getNodeSizes(int numEntries, int minEntries, int maxEntries, float fillFactor) {
+    int target = (int)round(fillFactor * maxEntries);
+    target = max(minEntries, min(maxEntries, target));
 
-                    // std::cout << "Index node (Internal Node) successfully accessed in process. This is the content: ---- |";
-                    fout << "Index node (Internal Node) successfully accessed in process. This is the content: ---- |";
+    int numNodes = max(1, (numEntries + target - 1) / target);
+    while (numNodes > 1 && numEntries / numNodes < minEntries) {
+        numNodes--;
+    }
 
-                    for (int x = 0; x < cursor->numKeys; x++) {
+    vector<int> sizes(numNodes, numEntries / numNodes);
+    for (int i = 0; i < numEntries % numNodes; i++) {
+        sizes[i]++;
+    }
+    return sizes;
+}
 
-                        // cout << cursor->keys[x] << "|";
-                        fout << cursor->keys[x] << "|";
-                             
-                    }
-                    fout << "\n";
-                    // cout <<"\n";
-                    cursor = ((InternalNode *)cursor)->pointers[i + 1];  // To go to the right subtree
+void BPTree::bulkLoad(vector<RID> &dataEntries, float fillFactor) {
+    // bulk loading only builds a new tree, insert into an existing one
+    if (root != nullptr) {
+        for (int i = 0; i < (int)dataEntries.size(); i++) {
+            Key newKey;
+            newKey.key_value = storage->getNumVotes(dataEntries[i]);
+            newKey.address.push_back(dataEntries[i]);
+            insert(newKey);
+        }
+        return;
+    }
+    if (dataEntries.empty()) {
+        return;
+    }
+    unique_lock<mutex> writer(writerLock, defer_lock);
+    if (concurrent) {
+        writer.lock();
+    }
 
-                    numIndexBlockAccessed++;
-                    numInternal++;
+    // sort (numVotes, RID) pairs by numVotes, the stable sort keeps ties in storage order like insert does
+    int numThreads = getNumThreads();
+    vector<pair<int, RID>> sortedEntries(dataEntries.size());
+    parallelFor(numThreads, numThreads, [&](int t) {
+        for (size_t i = t; i < dataEntries.size(); i += numThreads) {
+            sortedEntries[i] = make_pair(storage->getNumVotes(dataEntries[i]), dataEntries[i]);
+        }
+    });
+    parallelRadixSort(sortedEntries, [](const pair<int, RID> &entry) { return (unsigned)entry.first ^ 0x80000000u; }, numThreads);
+
+    // positions where each distinct key starts
+    vector<size_t> keyStarts;
+    for (size_t i = 0; i < sortedEntries.size(); i++) {
+        if (i == 0 || sortedEntries[i].first != sortedEntries[i - 1].first) {
+            keyStarts.push_back(i);
+        }
+    }
+    keyStarts.push_back(sortedEntries.size());
+    int numKeys = keyStarts.size() - 1;
+
+    // leaf level
+    vector<Node *> level;
+    vector<int> smallestKeys;  // smallest key under each node of the level
+    vector<long long> levelCounts;  // records under each node of the level, augmented trees only
+    vector<double> levelSums;
+    vector<int> leafSizes = getNodeSizes(numKeys, (maxKeys + 1) / 2, maxKeys, fillFactor);
+    int k = 0;
+    LeafNode *prevLeaf = nullptr;
+    for (int n = 0; n < (int)leafSizes.size(); n++) {
+        LeafNode *leaf = newLeafNode();
+        numNodes++;
+        for (int i = 0; i < leafSizes[n]; i++, k++) {
+            leaf->keys[i] = sortedEntries[keyStarts[k]].first;
+            leaf->pointers[i] = nullptr;
+            for (size_t j = keyStarts[k]; j < keyStarts[k + 1]; j++) {
+                leaf->pointers[i] = PostingList::add(leaf->pointers[i], sortedEntries[j].second);
+            }
+        }
+        leaf->numKeys = leafSizes[n];
+        if (augmented) {
+            levelCounts.push_back(0);
+            levelSums.push_back(0);
+            getTotals(leaf, levelCounts.back(), levelSums.back());
+        }
+        if (prevLeaf != nullptr) {
+            prevLeaf->nextLeaf = leaf;
+        }
+        prevLeaf = leaf;
+        level.push_back((Node *)leaf);
+        smallestKeys.push_back(leaf->keys[0]);
+    }
 
-                    break;
+    // internal levels, keys are the smallest key under each child but the first
+    while (level.size() > 1) {
+        vector<Node *> parentLevel;
+        vector<int> parentSmallestKeys;
+        vector<long long> parentCounts;
+        vector<double> parentSums;
+        vector<int> childCounts = getNodeSizes(level.size(), (maxKeys + 2) / 2, maxKeys + 1, fillFactor);
+        int c = 0;
+        for (int n = 0; n < (int)childCounts.size(); n++) {
+            InternalNode *internal = newInternalNode();
+            numNodes++;
+            parentSmallestKeys.push_back(smallestKeys[c]);
+            for (int i = 0; i < childCounts[n]; i++, c++) {
+                internal->pointers[i] = level[c];
+                if (i > 0) {
+                    internal->keys[i - 1] = smallestKeys[c];
+                }
+                if (augmented) {
+                    internal->recordCounts[i] = levelCounts[c];
+                    internal->ratingSums[i] = levelSums[c];
                 }
             }
+            internal->numKeys = childCounts[n] - 1;
+            parentLevel.push_back((Node *)internal);
+            if (augmented) {
+                parentCounts.push_back(0);
+                parentSums.push_back(0);
+                getTotals(internal, parentCounts.back(), parentSums.back());
+            }
         }
+        level = parentLevel;
+        smallestKeys = parentSmallestKeys;
+        levelCounts = parentCounts;
+        levelSums = parentSums;
+    }
+    beginWrite(nullptr, true);
+    storeRelease(root, level[0]);
+    if (concurrent) {
+        endWrite();
+    }
+}
 
-        // At this point, cursor has reached isLeaf = true, now we search through leaf node to find matching key or range
-        bool stopSearch = false;
-        bool flag = true;
-        LeafNode* leafCursor;
-        leafCursor = (LeafNode* ) cursor;
+StreamTraceSink::StreamTraceSink(ostream &out) : out(out) {}
 
-        // Search from this point onwards are searching within leaf nodes hence this layer onwards is dense index
-        while (stopSearch == false) {
-            int i;
-            // Key that is within given range is found, hence need to iterate through entire range until we reach upperBoundKey
-            for (i = 0; i < leafCursor->numKeys; i++) {
+void StreamTraceSink::internalNode(const int *keys, int numKeys) {
+    out << "Index node (Internal Node) successfully accessed in process. This is the content: ---- |";
+    for (int x = 0; x < numKeys; x++) {
+        out << keys[x] << "|";
+    }
+    out << "\n";
+}
 
-                if (leafCursor->keys[i] > upperBoundKey) {
+void StreamTraceSink::leafNode(const int *keys, int numKeys) {
+    out << "Index node (Leaf Node) successfully accessed in process. This is the content: ---- |";
+    for (int x = 0; x < numKeys; x++) {
+        out << keys[x] << "|";
+    }
+    out << "\n";
+}
 
-                    stopSearch = true;
-                    break;
-                }
-                // Meets range criteria or key value matches requirement
-                if (leafCursor->keys[i] >= lowerBoundKey && leafCursor->keys[i] <= upperBoundKey) {
-
-                    //flag is to ensure leaf node nt printed repeatedly in range query
-                    if (flag == true) {
-                        // printf("\n");
-                        // std::cout << "Index node (Leaf Node) successfully accessed in process. This is the content: ---- |";
-                        fout << "Index node (Leaf Node) successfully accessed in process. This is the content: ---- |";
-
-                        for (int x = 0; x < leafCursor->numKeys; x++) {
-
-                            // cout << cursor->keys[x] << "|";
-                            fout << leafCursor->keys[x] << "|";
-    
-                        }
-                        fout << "\n";
-                        // cout <<"\n";
-
-                        numIndexBlockAccessed++;
-                        numLeaf++;
-                    }
-                    // std::cout << endl;
-
-                    // Since now we are at leaf node and this key matches criteria, hence will now access the datablocks with this key value
-                    int size = ((LeafNode *)leafCursor)->pointers[i]->size();  // since 1 key can have many different records, need to find total number of records of this key value
-
-                    // printf("\n");
-                    int blockNum;
-                    for (int j = 0; j < size; ++j) {
-
-                        fout << "\n";
-                        // printf("Data block: ");
-                        // printf("%p", (uchar*)
-                        // cursor->keys[i].address[j]); printf("\n"); cout << "tconst: " << (*(Record *)cursor->keys[i].address[j]).tconst << "Rating: " << (*(Record *)cursor->keys[i].address[j]).averageRating << "numVotes: " << (*(Record *)cursor->keys[i].address[j]).numVotes << "\n";
-                        void *recordAddress = (*((LeafNode *)leafCursor)->pointers[i])[j];
-                        allRatings.push_back((*(Record *)recordAddress).averageRating);
-                        blockNum = (int)((uchar *)(Record *)recordAddress - (uchar *)startAddress) / __blockCapacity;
-                        fout << "Data Block Num: " << blockNum << endl;
-                        fout << "Record Address: " << recordAddress << std::endl;
-                        fout << "tconst: " << (*(Record *)recordAddress).tconst << " Rating: " << (*(Record *)recordAddress).averageRating << " numVotes: " << (*(Record *)recordAddress).numVotes << "\n" << std::endl;
-                        blockSet.insert(blockNum);
-                        numRecords++;
-                    }
-
-                    if (upperBoundKey == lowerBoundKey) {  // for search query
-
-                        averageRating = std::accumulate(allRatings.begin(),allRatings.end(), 0.0) / allRatings.size();
-                        get<0>(results) = numIndexBlockAccessed;
-                        get<1>(results) = blockSet.size();
-                        get<2>(results) = averageRating;
-                        fout << "Number of index nodes the process accessed: " << numIndexBlockAccessed << endl;
-                        fout << "Number of data blocks the process accessed: " << blockSet.size() << endl;
-                        fout << "Number of records accessed: " << numRecords << endl;
-                        fout << "Average Rating of all records returned : " << averageRating << endl;
-                        return results;
-                    }
-
-                    if (upperBoundKey != lowerBoundKey){  // for range query
-                        flag = false;
-                        
-                    }
-                }
-            }
-             // Since stopsearch is false, hence will continue searching through each key in next unexplored leaf node in the for loop above
-            if (leafCursor->nextLeaf != nullptr && leafCursor->keys[(leafCursor->numKeys) - 1] != upperBoundKey){
+BPTreeCursor::BPTreeCursor(BPTree *tree, TraceSink *sink) {
+    this->tree = tree;
+    this->sink = sink;
+    leaf = nullptr;
+    keyPos = 0;
+    upperBoundKey = 0;
+    key = 0;
+    leafAccessed = false;
+    numIndexNodes = 0;
+}
 
-                leafCursor = (LeafNode *) leafCursor -> nextLeaf;
-                flag = true;
+void BPTreeCursor::seek(int lowerBoundKey, int upperBoundKey) {
+    this->upperBoundKey = upperBoundKey;
+    numIndexNodes = 0;
+    leafAccessed = false;
+    posting.reset(nullptr);
+    leaf = nullptr;
+    if (tree->root == nullptr || lowerBoundKey > upperBoundKey) {
+        return;
+    }
 
-            } 
-            else{
-                stopSearch = true;
+    // proceed to the subtree left of the first key greater than lowerBoundKey
+    Node *cur = tree->root;
+    while (cur->isLeaf == false) {
+        if (sink != nullptr) {
+            sink->internalNode(cur->keys, cur->numKeys);
+        }
+        numIndexNodes++;
+        cur = ((InternalNode *)cur)->pointers[upperBound(cur->keys, cur->numKeys, lowerBoundKey)];
+    }
+    leaf = (LeafNode *)cur;
+    keyPos = lowerBound(leaf->keys, leaf->numKeys, lowerBoundKey);
+}
+
+bool BPTreeCursor::next(RID &rid) {
+    while (!posting.next(rid)) {
+        if (leaf == nullptr) {
+            return false;
+        }
+        // move to the next leaf, unless the range ends within this one
+        if (keyPos >= leaf->numKeys) {
+            if (leaf->numKeys > 0 && leaf->keys[leaf->numKeys - 1] >= upperBoundKey) {
+                leaf = nullptr;
+                return false;
             }
+            leaf = (LeafNode *)leaf->nextLeaf;
+            keyPos = 0;
+            leafAccessed = false;
+            continue;
+        }
+        if (leaf->keys[keyPos] > upperBoundKey) {
+            leaf = nullptr;
+            return false;
+        }
+        if (!leafAccessed) {
+            if (sink != nullptr) {
+                sink->leafNode(leaf->keys, leaf->numKeys);
+            }
+            numIndexNodes++;
+            leafAccessed = true;
+        }
+        key = leaf->keys[keyPos];
+        posting.reset(leaf->pointers[keyPos]);
+        keyPos++;
+    }
+    return true;
+}
+
+int BPTreeCursor::nextN(RID *rids, int n) {
+    int count = 0;
+    while (count < n && next(rids[count])) {
+        count++;
+    }
+    return count;
+}
+
+int BPTreeCursor::getKey() {
+    return key;
+}
+
+int BPTreeCursor::getNumIndexNodes() {
+    return numIndexNodes;
+}
+
+double Aggregate::average() const {
+    return sum / count;
+}
+
+// Set the bit of blockNum in a bitmap of data blocks, true if it was not set before
+static bool markBlock(vector<uint64_t> &blockBitmap, int blockNum) {
+    size_t word = blockNum >> 6;
+    if (word >= blockBitmap.size()) {
+        blockBitmap.resize(std::max(word + 1, blockBitmap.size() * 2), 0);
+    }
+    uint64_t bit = (uint64_t)1 << (blockNum & 63);
+    bool isNew = (blockBitmap[word] & bit) == 0;
+    blockBitmap[word] |= bit;
+    return isNew;
+}
+
+Record BPTree::readRecord(RID rid, BufferPool *bufferPool, int &blockNum) {
+    blockNum = getRIDBlock(rid);
+
+    // read the data block through the buffer pool, the in-memory copy only if every frame is pinned;
+    // queries never modify records, so frames are unpinned clean
+    if (bufferPool != nullptr) {
+        uchar *block = bufferPool->pinBlock(blockNum);
+        if (block != nullptr) {
+            Record record = storage->readRecord(block, rid);
+            bufferPool->unpinBlock(blockNum, false);
+            return record;
         }
+    }
+    return storage->readRecord(rid);
+}
+
+// without a buffer pool, PAX blocks are read in the minipage of the field only
+double BPTree::readField(RID rid, RecordField field, BufferPool *bufferPool, int &blockNum) {
+    if (bufferPool != nullptr) {
+        Record record = readRecord(rid, bufferPool, blockNum);
+        return (field == AVERAGE_RATING) ? record.averageRating : record.numVotes;
+    }
+    blockNum = getRIDBlock(rid);
+    return (field == AVERAGE_RATING) ? storage->getAverageRating(rid) : storage->getNumVotes(rid);
+}
 
-    } 
-    else{
+tuple<int, int, float> BPTree::searchExp(int lowerBoundKey, int upperBoundKey, string filename, BufferPool *bufferPool) {
+    tuple<int, int, float> results;
+    std::ofstream fout(filename + ".txt");
+    vector<uint64_t> blockBitmap;
+    int numBlocks = 0;
+    int numRecords = 0;
+    double ratingSum = 0;
+
+    // the cursor writes the index nodes it accesses, the data blocks are written here
+    StreamTraceSink trace(fout);
+    BPTreeCursor cursor(this, &trace);
+    if (root == nullptr) {
         std::cout << "Tree is empty, no content accessed.";
     }
+    cursor.seek(lowerBoundKey, upperBoundKey);
+
+    RID rid;
+    while (cursor.next(rid)) {
+        fout << "\n";
+        int blockNum;
+        Record record = readRecord(rid, bufferPool, blockNum);
+        ratingSum += record.averageRating;
+        fout << "Data Block Num: " << blockNum << endl;
+        fout << "Record Address: " << blockNum << ":" << getRIDSlot(rid) << std::endl;
+        fout << "tconst: " << record.tconst << " Rating: " << record.averageRating << " numVotes: " << record.numVotes << "\n" << std::endl;
+        numBlocks += markBlock(blockBitmap, blockNum);
+        numRecords++;
+    }
 
-    averageRating = std::accumulate(allRatings.begin(), allRatings.end(), 0.0) / allRatings.size();
+    int numIndexBlockAccessed = cursor.getNumIndexNodes();
+    float averageRating = ratingSum / numRecords;
     get<0>(results) = numIndexBlockAccessed;
-    get<1>(results) = blockSet.size();
+    get<1>(results) = numBlocks;
     get<2>(results) = averageRating;
     fout << "Number of index nodes the process accessed: " << numIndexBlockAccessed << endl;
-    fout << "Number of data blocks the process accessed: " << blockSet.size() << endl;
+    fout << "Number of data blocks the process accessed: " << numBlocks << endl;
     fout << "Number of records accessed: " << numRecords << endl;
     fout << "Average Rating of all records returned : " << averageRating << endl;
 
     return results;
 }
 
-int BPTree::remove(int key_value){
+// Stream a key range in batches; a concurrent tree is read one leaf at a time and,
+// when a writer got in the way, descended again from the first key not yet passed on
+int BPTree::scanRange(int lowerBoundKey, int upperBoundKey, const function<void(RID *, int)> &fn) {
+    if (!concurrent) {
+        BPTreeCursor cursor(this);
+        cursor.seek(lowerBoundKey, upperBoundKey);
+        RID batch[SCAN_BATCH_SIZE];
+        int n;
+        while ((n = cursor.nextN(batch, SCAN_BATCH_SIZE)) > 0) {
+            fn(batch, n);
+        }
+        return cursor.getNumIndexNodes();
+    }
+
+    int numIndexNodes = 0;
+    vector<RID> addresses;
+    int keyCopies[maxKeys + 1];
+    void *slotCopies[maxKeys + 1];
+
+    int reader = epochs->enter();
+    int nextKey = lowerBoundKey;
+    bool done = lowerBoundKey > upperBoundKey;
+    while (!done) {
+        uint64_t treeStamp;
+        int numNodes;
+        LeafNode *leaf = findLeafOptimistic(nextKey, treeStamp, numNodes);
+        if (leaf == nullptr) {
+            break;
+        }
+        numIndexNodes += numNodes;
 
-    Node *cur = search(key_value);
-    int i, numDeletions;
+        while (leaf != nullptr) {
+            uint64_t version = leaf->version.load(memory_order_acquire);
+            if (version & 1) {
+                break;
+            }
 
-    for (i = 0; i < cur->numKeys; i++) {
-        if (cur->keys[i] == key_value) {
+            // copy the keys in range and their slots
+            int n = min(max(loadRelaxed(leaf->numKeys), 0), maxKeys + 1);
+            int numCopies = 0;
+            for (int i = lowerBoundShared(leaf->keys, n, nextKey); i < n; i++) {
+                int key = loadRelaxed(leaf->keys[i]);
+                if (key > upperBoundKey) {
+                    break;
+                }
+                keyCopies[numCopies] = key;
+                slotCopies[numCopies++] = loadAcquire(leaf->pointers[i]);
+            }
+            bool lastLeaf = (n == 0 || loadRelaxed(leaf->keys[n - 1]) >= upperBoundKey);
+            LeafNode *nextLeaf = (LeafNode *)loadAcquire(leaf->nextLeaf);
+            if (!validate(leaf, version, treeStamp)) {
+                break;
+            }
+            addresses.clear();
+            for (int i = 0; i < numCopies; i++) {
+                collectAddresses(slotCopies[i], addresses);
+            }
+            if (!validate(leaf, version, treeStamp)) {
+                break;
+            }
+
+            // the leaf was consistent, its records are safe to read
+            if (!addresses.empty()) {
+                fn(addresses.data(), addresses.size());
+            }
+            numIndexNodes += (numCopies > 0);
+
+            if (lastLeaf || nextLeaf == nullptr) {
+                done = true;
+                break;
+            }
+            if (numCopies > 0) {
+                nextKey = keyCopies[numCopies - 1] + 1;
+            }
+            leaf = nextLeaf;
+        }
+    }
+    epochs->exit(reader);
+    return numIndexNodes;
+}
+
+void BPTree::addRange(int lowerBoundKey, int upperBoundKey, RecordField field, BufferPool *bufferPool, Aggregate &result, vector<uint64_t> &blockBitmap) {
+    result.numIndexNodes += scanRange(lowerBoundKey, upperBoundKey, [&](RID *addresses, int n) {
+        for (int i = 0; i < n; i++) {
+            int blockNum;
+            double value = readField(addresses[i], field, bufferPool, blockNum);
+            result.sum += value;
+            result.min = std::min(result.min, value);
+            result.max = std::max(result.max, value);
+            result.numDataBlocks += markBlock(blockBitmap, blockNum);
+        }
+        result.count += n;
+    });
+}
+
+Aggregate BPTree::aggregate(int lowerBoundKey, int upperBoundKey, RecordField field, BufferPool *bufferPool) {
+    Aggregate result = newAggregate();
+    vector<uint64_t> blockBitmap;
+    addRange(lowerBoundKey, upperBoundKey, field, bufferPool, result, blockBitmap);
+    return result;
+}
+
+// Gather separators in (lowerBoundKey, upperBoundKey] level by level from the root
+// until there are enough to split the range numParts ways
+vector<int> BPTree::getSplitKeys(int lowerBoundKey, int upperBoundKey, int numParts) {
+    vector<int> splitKeys;
+    if (numParts <= 1 || lowerBoundKey >= upperBoundKey) {
+        return splitKeys;
+    }
+    int reader = concurrent ? epochs->enter() : -1;
+    while (true) {
+        uint64_t treeStamp = treeVersion.load(memory_order_acquire);
+        if (treeStamp & 1) {  // writer is changing the structure
+            this_thread::yield();
+            continue;
+        }
+        splitKeys.clear();
+        vector<Node *> level;
+        Node *top = loadAcquire(root);
+        if (top != nullptr) {
+            level.push_back(top);
+        }
+        bool valid = true;
+        while (valid && !level.empty() && !level[0]->isLeaf && (int)splitKeys.size() + 1 < numParts) {
+            vector<Node *> children;
+            for (Node *cur : level) {
+                int n = min(max(loadRelaxed(cur->numKeys), 0), maxKeys + 1);
+                int first = upperBoundShared(cur->keys, n, lowerBoundKey);
+                int last = upperBoundShared(cur->keys, n, upperBoundKey);
+                for (int i = first; i < last; i++) {
+                    splitKeys.push_back(loadRelaxed(cur->keys[i]));
+                }
+                for (int i = first; i <= last; i++) {
+                    children.push_back(loadAcquire(((InternalNode *)cur)->pointers[i]));
+                }
+            }
+            // only go down to children read from nodes that did not change
+            atomic_thread_fence(memory_order_acquire);
+            valid = (treeVersion.load(memory_order_relaxed) == treeStamp);
+            level = children;
+        }
+        if (valid) {
             break;
         }
     }
-    vector<void *> *child = ((LeafNode *)cur)->pointers[i];
+    if (concurrent) {
+        epochs->exit(reader);
+    }
+
+    // separators of different levels interleave, keep about numParts - 1 evenly spaced ones
+    sort(splitKeys.begin(), splitKeys.end());
+    splitKeys.erase(unique(splitKeys.begin(), splitKeys.end()), splitKeys.end());
+    if ((int)splitKeys.size() > numParts - 1) {
+        vector<int> picked;
+        for (int p = 1; p < numParts; p++) {
+            picked.push_back(splitKeys[(long long)p * splitKeys.size() / numParts]);
+        }
+        picked.erase(unique(picked.begin(), picked.end()), picked.end());
+        splitKeys = picked;
+    }
+    return splitKeys;
+}
+
+Aggregate BPTree::aggregateParallel(int lowerBoundKey, int upperBoundKey, RecordField field, int numThreads) {
+    // a few parts per thread even out parts with more records
+    vector<int> splitKeys = getSplitKeys(lowerBoundKey, upperBoundKey, numThreads * 4);
+    int numParts = splitKeys.size() + 1;
+    vector<Aggregate> partials(numParts, newAggregate());
+    vector<vector<uint64_t>> blockBitmaps(numParts);
+    parallelFor(numParts, numThreads, [&](int p) {
+        int partLowerBound = (p == 0) ? lowerBoundKey : splitKeys[p - 1];
+        int partUpperBound = (p == numParts - 1) ? upperBoundKey : splitKeys[p] - 1;
+        addRange(partLowerBound, partUpperBound, field, nullptr, partials[p], blockBitmaps[p]);
+    });
+
+    // merge the parts, a block read by several parts counts once
+    Aggregate result = newAggregate();
+    vector<uint64_t> blockBitmap;
+    for (int p = 0; p < numParts; p++) {
+        result.count += partials[p].count;
+        result.sum += partials[p].sum;
+        result.min = std::min(result.min, partials[p].min);
+        result.max = std::max(result.max, partials[p].max);
+        result.numIndexNodes += partials[p].numIndexNodes;
+        if (blockBitmaps[p].size() > blockBitmap.size()) {
+            blockBitmap.resize(blockBitmaps[p].size(), 0);
+        }
+        for (size_t w = 0; w < blockBitmaps[p].size(); w++) {
+            blockBitmap[w] |= blockBitmaps[p][w];
+        }
+    }
+    for (size_t w = 0; w < blockBitmap.size(); w++) {
+        result.numDataBlocks += __builtin_popcountll(blockBitmap[w]);
+    }
+    return result;
+}
 
-    numDeletions = removeInternal(key_value, cur, child);
+vector<RID> BPTree::searchRange(int lowerBoundKey, int upperBoundKey, int numThreads) {
+    vector<int> splitKeys = getSplitKeys(lowerBoundKey, upperBoundKey, numThreads * 4);
+    int numParts = splitKeys.size() + 1;
+    vector<vector<RID>> parts(numParts);
+    parallelFor(numParts, numThreads, [&](int p) {
+        int partLowerBound = (p == 0) ? lowerBoundKey : splitKeys[p - 1];
+        int partUpperBound = (p == numParts - 1) ? upperBoundKey : splitKeys[p] - 1;
+        scanRange(partLowerBound, partUpperBound, [&](RID *addresses, int n) {
+            parts[p].insert(parts[p].end(), addresses, addresses + n);
+        });
+    });
+
+    // parts are in key order
+    size_t numAddresses = 0;
+    for (int p = 0; p < numParts; p++) {
+        numAddresses += parts[p].size();
+    }
+    vector<RID> addresses;
+    addresses.reserve(numAddresses);
+    for (int p = 0; p < numParts; p++) {
+        addresses.insert(addresses.end(), parts[p].begin(), parts[p].end());
+    }
+    return addresses;
+}
 
-    if (i == 0) {
-        int newKey = cur->keys[i];
+Aggregate BPTree::countRange(int lowerBoundKey, int upperBoundKey, BufferPool *bufferPool) {
+    if (!augmented) {
+        return aggregate(lowerBoundKey, upperBoundKey, AVERAGE_RATING, bufferPool);
+    }
+    Aggregate result = newAggregate();
+    result.min = NAN;
+    result.max = NAN;
+    if (root == nullptr || lowerBoundKey > upperBoundKey) {
+        return result;
+    }
+    vector<uint64_t> blockBitmap;
 
-        if (root != nullptr) {
-            Node *cursor = root;
+    // add the totals of children [from, to) of an internal node
+    auto addChildren = [&](InternalNode *cur, int from, int to) {
+        for (int i = from; i < to; i++) {
+            result.count += cur->recordCounts[i];
+            result.sum += cur->ratingSums[i];
+        }
+        result.numIndexNodes++;
+    };
+    // read the records of keys [from, to) of a boundary leaf
+    auto addRecords = [&](Node *leaf, int from, int to) {
+        for (int i = from; i < to; i++) {
+            PostingList::forEach(((LeafNode *)leaf)->pointers[i], [&](RID rid) {
+                int blockNum;
+                result.count++;
+                result.sum += readField(rid, AVERAGE_RATING, bufferPool, blockNum);
+                result.numDataBlocks += markBlock(blockBitmap, blockNum);
+            });
+        }
+        result.numIndexNodes++;
+    };
+
+    // down the shared part of the paths to both bounds, children between the paths are in range
+    Node *lowerNode = root;
+    Node *upperNode = root;
+    while (!lowerNode->isLeaf && lowerNode == upperNode) {
+        InternalNode *cur = (InternalNode *)lowerNode;
+        int lowerPos = upperBound(cur->keys, cur->numKeys, lowerBoundKey);
+        int upperPos = upperBound(cur->keys, cur->numKeys, upperBoundKey);
+        addChildren(cur, lowerPos + 1, upperPos);
+        lowerNode = cur->pointers[lowerPos];
+        upperNode = cur->pointers[upperPos];
+    }
+    if (lowerNode == upperNode) {
+        addRecords(lowerNode, lowerBound(lowerNode->keys, lowerNode->numKeys, lowerBoundKey),
+                   upperBound(lowerNode->keys, lowerNode->numKeys, upperBoundKey));
+        return result;
+    }
+
+    // below the split, children right of the lower path and left of the upper path are in range
+    while (!lowerNode->isLeaf) {
+        InternalNode *cur = (InternalNode *)lowerNode;
+        int pos = upperBound(cur->keys, cur->numKeys, lowerBoundKey);
+        addChildren(cur, pos + 1, cur->numKeys + 1);
+        lowerNode = cur->pointers[pos];
+    }
+    addRecords(lowerNode, lowerBound(lowerNode->keys, lowerNode->numKeys, lowerBoundKey), lowerNode->numKeys);
 
-            bool found = false;
+    while (!upperNode->isLeaf) {
+        InternalNode *cur = (InternalNode *)upperNode;
+        int pos = upperBound(cur->keys, cur->numKeys, upperBoundKey);
+        addChildren(cur, 0, pos);
+        upperNode = cur->pointers[pos];
+    }
+    addRecords(upperNode, 0, upperBound(upperNode->keys, upperNode->numKeys, upperBoundKey));
+    return result;
+}
 
-            while (!cursor->isLeaf) {
-                for (int i = 0; i < cursor->numKeys; i++) {
+// Descend without locks, a descent only counts if treeVersion did not move meanwhile
+LeafNode *BPTree::findLeafOptimistic(int key_value, uint64_t &treeStamp, int &numNodes) {
+    while (true) {
+        treeStamp = treeVersion.load(memory_order_acquire);
+        if (treeStamp & 1) {  // writer is changing the structure
+            this_thread::yield();
+            continue;
+        }
+        Node *cur = loadAcquire(root);
+        numNodes = 0;
+        bool valid = true;
+        while (cur != nullptr && !cur->isLeaf) {
+            // a racing writer can leave any numKeys behind, keep the search inside the node
+            int n = min(max(loadRelaxed(cur->numKeys), 0), maxKeys + 1);
+            Node *child = loadAcquire(((InternalNode *)cur)->pointers[upperBoundShared(cur->keys, n, key_value)]);
+
+            // only follow child if it was read from a node that did not change
+            atomic_thread_fence(memory_order_acquire);
+            if (treeVersion.load(memory_order_relaxed) != treeStamp) {
+                valid = false;
+                break;
+            }
+            cur = child;
+            numNodes++;
+        }
+        atomic_thread_fence(memory_order_acquire);
+        if (valid && treeVersion.load(memory_order_relaxed) == treeStamp) {
+            return (LeafNode *)cur;
+        }
+    }
+}
 
-                    if (key_value == cursor->keys[i]) {
-                        cursor->keys[i] = newKey;
-                    }
+bool BPTree::validate(Node *leaf, uint64_t version, uint64_t treeStamp) {
+    atomic_thread_fence(memory_order_acquire);
+    return leaf->version.load(memory_order_relaxed) == version && treeVersion.load(memory_order_relaxed) == treeStamp;
+}
 
-                    if (key_value < cursor->keys[i]) {
-                        cursor = ((InternalNode *)cursor)->pointers[i];
-                        break;
-                    }
-                    // If we reached the end of all keys in this node(larger than all), then go to the right pointer's node to continue searching.
-                    if (i == cursor->numKeys - 1) {
-                        // Set cursor to the child node, now loaded in main memory.
-                        cursor = ((InternalNode *)cursor)->pointers[i + 1];
-                        break;
-                    }
-                }
+void BPTree::collectAddresses(void *slot, vector<RID> &addresses) {
+    PostingCursor posting;
+    posting.reset(slot);
+    RID address;
+    while (posting.next(address)) {
+        addresses.push_back(address);
+    }
+}
+
+vector<RID> BPTree::lookup(int key_value) {
+    vector<RID> addresses;
+    int reader = concurrent ? epochs->enter() : -1;
+    while (true) {
+        uint64_t treeStamp;
+        int numNodes;
+        LeafNode *leaf = findLeafOptimistic(key_value, treeStamp, numNodes);
+        if (leaf == nullptr) {
+            break;
+        }
+        uint64_t version = leaf->version.load(memory_order_acquire);
+        if (version & 1) {
+            continue;
+        }
+
+        // the slot has to be valid before its posting list is read,
+        // and the list unchanged afterwards before its addresses are used
+        int n = min(max(loadRelaxed(leaf->numKeys), 0), maxKeys + 1);
+        int pos = lowerBoundShared(leaf->keys, n, key_value);
+        void *slot = (pos < n && loadRelaxed(leaf->keys[pos]) == key_value) ? loadAcquire(leaf->pointers[pos]) : nullptr;
+        if (!validate(leaf, version, treeStamp)) {
+            continue;
+        }
+        addresses.clear();
+        collectAddresses(slot, addresses);
+        if (validate(leaf, version, treeStamp)) {
+            break;
+        }
+    }
+    if (concurrent) {
+        epochs->exit(reader);
+    }
+    return addresses;
+}
+
+bool BPTree::isConcurrent() {
+    return concurrent;
+}
+
+bool BPTree::isAugmented() {
+    return augmented;
+}
+
+// remove key_value, one writer at a time in a concurrent tree
+int BPTree::remove(int key_value) {
+    if (!concurrent) {
+        return removeKey(key_value);
+    }
+    lock_guard<mutex> writer(writerLock);
+    int numDeleted = removeKey(key_value);  // throws before changing anything
+    endWrite();
+    return numDeleted;
+}
+
+int BPTree::removeKey(int key_value) {
+    if (root == nullptr) {
+        throw std::logic_error("Tree is empty!");
+    }
+
+    InternalNode *path[MAX_HEIGHT];
+    int childPos[MAX_HEIGHT];
+    int depth = findPath(key_value, path, childPos);
+    LeafNode *cur = (LeafNode *)path[depth];
+
+    int pos = lowerBound(cur->keys, cur->numKeys, key_value);
+    if (pos == cur->numKeys || cur->keys[pos] != key_value) {
+        throw std::logic_error("Not found!");
+    }
+
+    // only an underflow or a separator that may need fixing changes more than this leaf
+    int minKeys = (maxKeys + 1) / 2;
+    beginWrite(cur, augmented || pos == 0 || (depth == 0 ? cur->numKeys == 1 : cur->numKeys - 1 < minKeys));
+
+    // drop the key and its records' addresses from the leaf
+    if (augmented) {
+        long long count;
+        double ratingSum;
+        getTotals(cur->pointers[pos], count, ratingSum);
+        addToPath(path, childPos, depth, -count, -ratingSum);
+    }
+    deleteRecords(cur->pointers[pos]);
+    releasePosting(cur->pointers[pos]);
+    for (int i = pos; i < cur->numKeys - 1; i++) {
+        storeRelaxed(cur->keys[i], cur->keys[i + 1]);
+        storeRelease(cur->pointers[i], cur->pointers[i + 1]);
+    }
+    storeRelaxed(cur->numKeys, cur->numKeys - 1);
+
+    // a separator equal to the removed key now points at the leaf's new smallest key
+    if (pos == 0 && cur->numKeys > 0) {
+        for (int d = depth - 1; d >= 0; d--) {
+            if (childPos[d] > 0 && path[d]->keys[childPos[d] - 1] == key_value) {
+                storeRelaxed(path[d]->keys[childPos[d] - 1], cur->keys[0]);
+                break;
             }
         }
     }
-    return numDeletions;
+
+    if (depth == 0) {
+        if (cur->numKeys == 0) {  // last key of the tree
+            releaseNode(cur);
+            numNodes--;
+            storeRelease(root, (Node *)nullptr);
+            return 1;
+        }
+        return 0;
+    }
+    if (cur->numKeys >= minKeys) {
+        return 0;
+    }
+
+    InternalNode *parent = path[depth - 1];
+    int leafPos = childPos[depth - 1];
+    LeafNode *leftNode = (leafPos > 0) ? (LeafNode *)parent->pointers[leafPos - 1] : nullptr;
+    LeafNode *rightNode = (leafPos < parent->numKeys) ? (LeafNode *)parent->pointers[leafPos + 1] : nullptr;
+
+    // Sharing keys/pointers with a sibling that has spare keys
+    if (leftNode != nullptr && leftNode->numKeys > minKeys) {
+        for (int i = cur->numKeys; i > 0; i--) {
+            storeRelaxed(cur->keys[i], cur->keys[i - 1]);
+            storeRelease(cur->pointers[i], cur->pointers[i - 1]);
+        }
+        storeRelaxed(cur->keys[0], leftNode->keys[leftNode->numKeys - 1]);
+        storeRelease(cur->pointers[0], leftNode->pointers[leftNode->numKeys - 1]);
+        storeRelaxed(cur->numKeys, cur->numKeys + 1);
+        storeRelaxed(leftNode->numKeys, leftNode->numKeys - 1);
+        storeRelaxed(parent->keys[leafPos - 1], cur->keys[0]);
+        if (augmented) {
+            long long count;
+            double ratingSum;
+            getTotals(cur->pointers[0], count, ratingSum);
+            shiftTotals(parent, leafPos - 1, leafPos, count, ratingSum);
+        }
+        return 0;
+    }
+    if (rightNode != nullptr && rightNode->numKeys > minKeys) {
+        storeRelaxed(cur->keys[cur->numKeys], rightNode->keys[0]);
+        storeRelease(cur->pointers[cur->numKeys], rightNode->pointers[0]);
+        storeRelaxed(cur->numKeys, cur->numKeys + 1);
+        if (augmented) {
+            long long count;
+            double ratingSum;
+            getTotals(rightNode->pointers[0], count, ratingSum);
+            shiftTotals(parent, leafPos + 1, leafPos, count, ratingSum);
+        }
+        for (int i = 0; i < rightNode->numKeys - 1; i++) {
+            storeRelaxed(rightNode->keys[i], rightNode->keys[i + 1]);
+            storeRelease(rightNode->pointers[i], rightNode->pointers[i + 1]);
+        }
+        storeRelaxed(rightNode->numKeys, rightNode->numKeys - 1);
+        storeRelaxed(parent->keys[leafPos], rightNode->keys[0]);
+        return 0;
+    }
+
+    // Merge nodes, the right leaf of the pair goes into the left one
+    LeafNode *left = (leftNode != nullptr) ? leftNode : cur;
+    LeafNode *right = (leftNode != nullptr) ? cur : rightNode;
+    int sepPos = (leftNode != nullptr) ? leafPos - 1 : leafPos;
+
+    for (int i = 0; i < right->numKeys; i++) {
+        storeRelaxed(left->keys[left->numKeys + i], right->keys[i]);
+        storeRelease(left->pointers[left->numKeys + i], right->pointers[i]);
+    }
+    storeRelaxed(left->numKeys, left->numKeys + right->numKeys);
+    storeRelease(left->nextLeaf, right->nextLeaf);
+
+    if (augmented) {
+        shiftTotals(parent, sepPos + 1, sepPos, parent->recordCounts[sepPos + 1], parent->ratingSums[sepPos + 1]);
+    }
+    removeChild(parent, sepPos);
+    releaseNode(right);
+    numNodes--;
+
+    return 1 + removeInternal(path, childPos, depth - 1);
 }
 
-vector<void *> BPTree::getAddresses(int key_value){
+vector<RID> BPTree::getAddresses(int key_value){
 
     LeafNode *cursor = search(key_value);
 
     for (int i = 0; i < cursor->numKeys; i++) {
         if (cursor->keys[i] == key_value) {
-            return *(cursor->pointers[i]);
+            return PostingList::getAddresses(cursor->pointers[i]);
         }
     }
-    return vector<void *>();
+    return vector<RID>();
 }
 
 void BPTree::displayTree(Node *head){
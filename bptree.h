@@ -1,15 +1,27 @@
 #ifndef BPTREE_H
 #define BPTREE_H
 
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <ostream>
 #include <vector>
 
+#include "bufferpool.h"
+#include "epoch.h"
+#include "nodearena.h"
+#include "posting.h"
+#include "rid.h"
 #include "storage.h"
 
 typedef unsigned char uchar;
 
 struct Key {
     int key_value;
-    vector<void *> address;  // array of address for records with same key_value
+    vector<RID> address;  // array of RIDs for records with same key_value
 };
 
 class Node {
@@ -18,30 +30,100 @@ class Node {
     void **pointers;
     int numKeys;  // number of keys in this node
     bool isLeaf; //if node is leaf or internal
+    atomic<uint64_t> version;  // odd while a writer changes the node, used by concurrent trees
     friend class BPTree;
 };
 
 class InternalNode : private Node {
    private:
     Node **pointers;  // array of pointers to other Nodes
+    long long *recordCounts;  // records under each child, nullptr unless the tree is augmented
+    double *ratingSums;       // sum of averageRating under each child, nullptr unless augmented
 
    public:
-    // Constructor
-    InternalNode(int maxKeys);
+    // Constructor, the node must sit at the start of a NodeArena buffer
+    InternalNode(int maxKeys, bool augmented);
     friend class BPTree;
+    friend class BPTreeCursor;
 };
 
 class LeafNode : private Node {
    private:
-    vector<void *> **pointers;  // array of addresses to data in memory
+    void **pointers;  // posting list slots holding the RIDs of records in Storage
     Node *nextLeaf;
 
    public:
-    // Constructor
+    // Constructor, the node must sit at the start of a NodeArena buffer
     LeafNode(int maxKeys);
     friend class BPTree;
+    friend class BPTreeCursor;
 };
 
+#define MAX_HEIGHT 64  // deepest root-to-leaf path a BPTree can have
+
+// A record copied to another slot by a vacuum, with the key it is indexed under
+struct RecordMove {
+    int key;
+    RID from;
+    RID to;
+};
+
+// Receives the index nodes a range scan accesses
+class TraceSink {
+   public:
+    virtual ~TraceSink() {}
+
+    // internal node on the way down to the first leaf
+    virtual void internalNode(const int *, int) {}
+
+    // leaf holding at least one key in range
+    virtual void leafNode(const int *, int) {}
+};
+
+// Writes accessed index nodes to a stream in the format of the experiment files
+class StreamTraceSink : public TraceSink {
+   private:
+    ostream &out;
+
+   public:
+    StreamTraceSink(ostream &out);
+
+    void internalNode(const int *keys, int numKeys) override;
+
+    void leafNode(const int *keys, int numKeys) override;
+};
+
+// Record fields a range aggregate can run over
+enum RecordField {
+    AVERAGE_RATING,
+    NUM_VOTES
+};
+
+// COUNT/SUM/MIN/MAX of a record field over a key range
+struct Aggregate {
+    long long count;    // num of records in range
+    double sum;
+    double min;         // +inf for an empty range
+    double max;         // -inf for an empty range
+    int numIndexNodes;  // index nodes accessed
+    int numDataBlocks;  // distinct data blocks accessed
+
+    // AVG of the field, NaN for an empty range
+    double average() const;
+};
+
+// Aggregate of no records, the start of every aggregate query
+inline Aggregate newAggregate() {
+    Aggregate result;
+    result.count = 0;
+    result.sum = 0;
+    result.min = INFINITY;
+    result.max = -INFINITY;
+    result.numIndexNodes = 0;
+    result.numDataBlocks = 0;
+    return result;
+}
+
 class BPTree {
    private:
     Node *root;    // Root Node Pointer
@@ -50,38 +132,145 @@ class BPTree {
     int numNodes;  // Num of nodes in B+ Tree
     int nodeSize;  // Size of a Node
     int __blockCapacity;
+    Storage *storage;  // holds the records the RIDs in the leaves point at
+    bool augmented;  // internal nodes keep record counts and rating sums of their children
+    NodeArena *nodeArena;  // buffers holding every node with its keys and pointers
+
+    // Concurrent trees let readers run optimistically beside one writer at a time.
+    // A change inside one leaf makes the leaf's version odd while it lasts,
+    // any other change makes treeVersion odd. Readers restart when a version moved.
+    bool concurrent;
+    mutex writerLock;             // held by insert, remove and bulkLoad
+    atomic<uint64_t> treeVersion; // odd while a writer changes the tree structure
+    Node *writingLeaf;            // leaf whose version the writer made odd
+    bool writingStructure;        // writer made treeVersion odd
+    EpochManager *epochs;         // holds back frees of nodes and posting lists readers may see
+    friend class BPTreeCursor;
+
+    // create nodes in the node arena
+    InternalNode *newInternalNode();
+    LeafNode *newLeafNode();
+
+    //insert key and child into path[depth], splitting up the path if needed
+    void insertInternal(int newKey, InternalNode **path, int depth, Node *child);
+
+    //rebalance underfull internal node path[depth], returns num of nodes deleted
+    int removeInternal(InternalNode **path, int *childPos, int depth);
+
+    //remove key at keyPos and the pointer right of it from an internal node
+    void removeChild(InternalNode *cur, int keyPos);
+
+    //copy a child pointer, with its totals in an augmented tree
+    void moveChild(InternalNode *to, int toPos, InternalNode *from, int fromPos);
+
+    //get num of records and rating sum under a node, or under one leaf slot
+    void getTotals(Node *cur, long long &count, double &ratingSum);
+    void getTotals(void *slot, long long &count, double &ratingSum);
+
+    //insert or remove without the writer lock
+    void insertKey(Key newKey);
+    int removeKey(int key_value);
+
+    //make leaf (or the whole tree if structural) odd before a concurrent writer changes it
+    void beginWrite(Node *leaf, bool structural);
+
+    //make the versions changed by beginWrite even again and free what readers are done with
+    void endWrite();
+
+    //give back a node or posting list, once readers are done with it in a concurrent tree
+    void releaseNode(Node *cur);
+    void releasePosting(void *slot);
+
+    //delete the records of a leaf slot from slotted storage, once readers are done with them
+    void deleteRecords(void *slot);
+    void deleteRecords(const vector<RID> &rids);
 
-    //insert internal nodes into b+ tree
-    void insertInternal(int newKey, InternalNode *parent, Node *child);
+    //descend to the leaf for key_value without locks, restarting until no writer got in the way,
+    //nullptr for an empty tree; treeStamp gets the treeVersion the descent was valid for
+    LeafNode *findLeafOptimistic(int key_value, uint64_t &treeStamp, int &numNodes);
 
-    //remove internal nodes from b+ tree
-    int removeInternal(int targetKey, Node *parent, void *child);
+    //true if leaf still has version and the tree still has treeStamp
+    bool validate(Node *leaf, uint64_t version, uint64_t treeStamp);
+
+    //copy the RIDs of a leaf slot, safe while a writer changes the slot
+    void collectAddresses(void *slot, vector<RID> &addresses);
+
+    //pass the RIDs of keys in [lowerBoundKey, upperBoundKey] to fn in key order, a batch at a time,
+    //safe beside writers in a concurrent tree; returns num of index nodes accessed
+    int scanRange(int lowerBoundKey, int upperBoundKey, const function<void(RID *, int)> &fn);
+
+    //add the records of keys in [lowerBoundKey, upperBoundKey] to result, marking their data blocks in blockBitmap
+    void addRange(int lowerBoundKey, int upperBoundKey, RecordField field, BufferPool *bufferPool, Aggregate &result, vector<uint64_t> &blockBitmap);
+
+    //separator keys splitting [lowerBoundKey, upperBoundKey] into at most numParts disjoint parts,
+    //each key starts a part
+    vector<int> getSplitKeys(int lowerBoundKey, int upperBoundKey, int numParts);
+
+    //add to the totals of every child on the path to the leaf at depth
+    void addToPath(InternalNode **path, int *childPos, int depth, long long count, double ratingSum);
+
+    //move totals between children fromPos and toPos of cur
+    void shiftTotals(InternalNode *cur, int fromPos, int toPos, long long count, double ratingSum);
 
     //get smallest key in node
     int getSmallestKey(Node *cur);
 
-    //find parent node of current node
-    InternalNode *findParent(Node *cur, Node *child);
-
-    //find parent including leaf
-    Node *findParentInclLeaf(Node *cur, Node *child);
+    //record root-to-leaf path for key_value, returns depth of the leaf
+    int findPath(int key_value, InternalNode **path, int *childPos);
 
     //get address 
-    vector<void *> getAddresses(int key_value);
+    vector<RID> getAddresses(int key_value);
+
+    //copy record rid, through bufferPool if given, and get its data block num
+    Record readRecord(RID rid, BufferPool *bufferPool, int &blockNum);
+
+    //read one field of record rid, through bufferPool if given, and get its data block num
+    double readField(RID rid, RecordField field, BufferPool *bufferPool, int &blockNum);
 
    public:
-    // Constructor
-    BPTree(int blockCapacity);
+    // Constructor for an index over the records of storage, nodes are the size of its blocks.
+    // An augmented tree answers countRange without walking the leaves.
+    // A concurrent tree takes insert, remove, lookup and aggregate from many threads;
+    // the other queries still need the tree to themselves
+    BPTree(Storage *storage, bool augmented = false, bool concurrent = false);
+
+    // Destructor
+    ~BPTree();
 
     // insert new Key
     void insert(Key newKey);
 
-    //remove Node
+    // build tree bottom-up from the RIDs of records in storage, nodes filled to fillFactor
+    void bulkLoad(vector<RID> &dataEntries, float fillFactor);
+
+    //remove Node, the records of key_value are deleted too when storage has slotted blocks
     int remove(int key_value);
 
+    //point the leaf entries of moved records at their copies, one leaf at a time in key order,
+    //and delete the originals once readers are done with them; a copy whose original is no longer
+    //in the tree is deleted instead. Returns num of moves applied
+    int moveRecords(vector<RecordMove> &moves);
+
+    //rewrite storage with the records in key order and point the leaves at their new RIDs,
+    //so a key range reads contiguous blocks; records the tree does not hold are dropped.
+    //Run again once inserts have scattered records; no other thread may use the tree meanwhile
+    void cluster();
+
+    //rewrite storage with the records in their block order and point the leaves at their new RIDs,
+    //which compresses the blocks of COMPRESSED_BLOCKS storage; records the tree does not hold stay.
+    //No other thread may use the tree meanwhile
+    void compress();
+
     //serach for key
     LeafNode *search(int key_value);
 
+    //RIDs of the records with key_value, empty if there are none
+    vector<RID> lookup(int key_value);
+
+    //search numKeys keys at once, level by level with the next level prefetched;
+    //slots[i] gets the leaf slot of keys[i] (see PostingList) or nullptr if it is not in the tree
+    void multiSearch(const int *keys, int numKeys, void **slots);
+
     // print for experiment 2
     void displayBlock(Node *cur);
 
@@ -91,8 +280,28 @@ class BPTree {
     //get root
     Node *getRoot();
 
-    //search for expriment 3 and 4
-    tuple<int, int, float> searchExp(int lowerBoundKey, int upperBoundKey, string filename);
+    //search for expriment 3 and 4, data blocks are read through bufferPool if given
+    tuple<int, int, float> searchExp(int lowerBoundKey, int upperBoundKey, string filename, BufferPool *bufferPool = nullptr);
+
+    //aggregate field over keys in [lowerBoundKey, upperBoundKey] in one streaming pass, no trace file
+    Aggregate aggregate(int lowerBoundKey, int upperBoundKey, RecordField field, BufferPool *bufferPool = nullptr);
+
+    //aggregate with the range split at separator keys into parts scanned by numThreads threads,
+    //data blocks are read from memory
+    Aggregate aggregateParallel(int lowerBoundKey, int upperBoundKey, RecordField field, int numThreads);
+
+    //RIDs of keys in [lowerBoundKey, upperBoundKey] in key order, scanned like aggregateParallel
+    vector<RID> searchRange(int lowerBoundKey, int upperBoundKey, int numThreads);
+
+    //COUNT and SUM/AVG of averageRating over keys in [lowerBoundKey, upperBoundKey],
+    //reads only the two boundary leaves in an augmented tree (min and max are NaN then)
+    Aggregate countRange(int lowerBoundKey, int upperBoundKey, BufferPool *bufferPool = nullptr);
+
+    //true if internal nodes keep child totals
+    bool isAugmented();
+
+    //true if readers and writers may share the tree
+    bool isConcurrent();
 
     //get height of b+ tree
     int getHeight(Node *cur);
@@ -104,4 +313,38 @@ class BPTree {
     int getMaxKeys();
 
 };
+
+// Streams the RIDs of a key range from the leaf chain,
+// with no I/O and no allocation per record
+class BPTreeCursor {
+   private:
+    BPTree *tree;
+    TraceSink *sink;       // optional, told about each index node accessed
+    LeafNode *leaf;        // leaf being read, nullptr once the scan is done
+    int keyPos;            // next key in leaf
+    int upperBoundKey;     // last key of the range
+    int key;               // key of the last RID returned
+    bool leafAccessed;     // leaf already counted and traced
+    int numIndexNodes;     // index nodes accessed since seek
+    PostingCursor posting; // RIDs of the current key
+
+   public:
+    // Constructor, sink may be nullptr
+    BPTreeCursor(BPTree *tree, TraceSink *sink = nullptr);
+
+    // position before the first key >= lowerBoundKey, the scan ends after upperBoundKey
+    void seek(int lowerBoundKey, int upperBoundKey = INT_MAX);
+
+    // get the next RID in key order, false at the end of the range
+    bool next(RID &rid);
+
+    // get up to n RIDs, returns how many were written (0 at the end)
+    int nextN(RID *rids, int n);
+
+    // key of the last RID returned
+    int getKey();
+
+    // num of index nodes accessed, leaves are counted once a key in range is found
+    int getNumIndexNodes();
+};
 #endif
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include "bufferpool.h"
+
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "storage.h"
+
+typedef unsigned char uchar;
+
+using namespace std;
+
+//BufferPool Constructor
+BufferPool::BufferPool(string filename, int blockCapacity, int numFrames){
+    __blockCapacity = blockCapacity;
+    __numFrames = numFrames;
+    __file.open(filename, ios::in | ios::out | ios::binary);
+
+    __frameData = new uchar[(long long) numFrames * blockCapacity];
+    __frames.resize(numFrames);
+    for (int i = 0; i < numFrames; i++){
+        __frames[i].blockNum = -1;
+        __frames[i].pinCount = 0;
+        __frames[i].dirty = false;
+        __frames[i].referenced = false;
+        __frames[i].data = __frameData + (long long) i * blockCapacity;
+    }
+    __clockHand = 0;
+    resetStats();
+}
+
+//BufferPool Destructor
+BufferPool::~BufferPool(){
+    flushAll();
+    __file.close();
+    delete[] __frameData;
+    __frameData = nullptr;
+}
+
+bool BufferPool::isOpen(){
+    return __file.is_open();
+}
+
+//Read a block from the block file into dest
+void BufferPool::readBlock(int blockNum, uchar *dest){
+    __file.clear();
+    __file.seekg(STORAGE_HEADER_SIZE + (long long) blockNum * __blockCapacity);
+    __file.read((char *) dest, __blockCapacity);
+    __physicalReads++;
+}
+
+//Write a block from src into the block file
+void BufferPool::writeBlock(int blockNum, uchar *src){
+    __file.clear();
+    __file.seekp(STORAGE_HEADER_SIZE + (long long) blockNum * __blockCapacity);
+    __file.write((char *) src, __blockCapacity);
+    __physicalWrites++;
+}
+
+//Sweep frames clearing reference bits until an unpinned, unreferenced frame is found
+int BufferPool::findVictim(){
+    for (int swept = 0; swept < 2 * __numFrames; swept++){
+        Frame &frame = __frames[__clockHand];
+        int cur = __clockHand;
+        __clockHand = (__clockHand + 1) % __numFrames;
+
+        if (frame.pinCount > 0){
+            continue;
+        }
+        if (frame.referenced){ //second chance
+            frame.referenced = false;
+            continue;
+        }
+        return cur;
+    }
+    return -1; //every frame is pinned
+}
+
+//Pin a block in a frame, reading it from the block file on a miss
+uchar *BufferPool::pinBlock(int blockNum){
+    unordered_map<int, int>::iterator it = __pageTable.find(blockNum);
+    if (it != __pageTable.end()){
+        Frame &frame = __frames[it->second];
+        frame.pinCount++;
+        frame.referenced = true;
+        __hits++;
+        return frame.data;
+    }
+
+    __misses++;
+    int victim = findVictim();
+    if (victim < 0){ //callers fall back to the in-memory block
+        return nullptr;
+    }
+
+    Frame &frame = __frames[victim];
+    if (frame.blockNum >= 0){ //evict previous block
+        if (frame.dirty){
+            writeBlock(frame.blockNum, frame.data);
+        }
+        __pageTable.erase(frame.blockNum);
+    }
+
+    readBlock(blockNum, frame.data);
+    frame.blockNum = blockNum;
+    frame.pinCount = 1;
+    frame.dirty = false;
+    frame.referenced = true;
+    __pageTable[blockNum] = victim;
+    return frame.data;
+}
+
+//Release a pinned block
+void BufferPool::unpinBlock(int blockNum, bool dirty){
+    unordered_map<int, int>::iterator it = __pageTable.find(blockNum);
+    if (it == __pageTable.end()){
+        return;
+    }
+    Frame &frame = __frames[it->second];
+    if (frame.pinCount > 0){
+        frame.pinCount--;
+    }
+    frame.dirty = frame.dirty || dirty;
+}
+
+//Write all dirty frames back to the block file
+void BufferPool::flushAll(){
+    for (int i = 0; i < __numFrames; i++){
+        if (__frames[i].blockNum >= 0 && __frames[i].dirty){
+            writeBlock(__frames[i].blockNum, __frames[i].data);
+            __frames[i].dirty = false;
+        }
+    }
+    __file.flush();
+}
+
+int BufferPool::getNumFrames(){
+    return __numFrames;
+}
+
+int BufferPool::getHits(){
+    return __hits;
+}
+
+int BufferPool::getMisses(){
+    return __misses;
+}
+
+int BufferPool::getPhysicalReads(){
+    return __physicalReads;
+}
+
+int BufferPool::getPhysicalWrites(){
+    return __physicalWrites;
+}
+
+//Reset hit, miss and I/O counters
+void BufferPool::resetStats(){
+    __hits = 0;
+    __misses = 0;
+    __physicalReads = 0;
+    __physicalWrites = 0;
+}
@@ -0,0 +1,79 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+typedef unsigned char uchar;
+
+using namespace std;
+
+// Frame holding a copy of one block
+struct Frame {
+    int blockNum;     // block held by the frame, -1 if empty
+    int pinCount;     // num of users of the frame
+    bool dirty;       // frame modified since it was read
+    bool referenced;  // CLOCK reference bit
+    uchar *data;      // block contents
+};
+
+// Caches data blocks of a Storage block file in a fixed number of frames for queries.
+// Index nodes stay in memory and never go through the pool.
+class BufferPool {
+    private:
+        fstream __file; //block file
+        int __blockCapacity; //size of a block
+        int __numFrames; //num of frames in the pool
+
+        uchar *__frameData; //contents of all frames
+        vector<Frame> __frames;
+        unordered_map<int, int> __pageTable; //block num -> frame index
+        int __clockHand; //next frame checked by CLOCK
+
+        //statistics
+        int __hits;
+        int __misses;
+        int __physicalReads;
+        int __physicalWrites;
+
+        //pick an unpinned frame with CLOCK, -1 if all frames are pinned
+        int findVictim();
+
+        void readBlock(int blockNum, uchar *dest);
+
+        void writeBlock(int blockNum, uchar *src);
+
+    public:
+        //constructor for a block file created by Storage
+        BufferPool(string filename, int blockCapacity, int numFrames);
+
+        //destructor, writes back dirty frames
+        ~BufferPool();
+
+        bool isOpen();
+
+        //pin block in a frame, reading it if needed, nullptr if all frames are pinned
+        uchar *pinBlock(int blockNum);
+
+        //release a pinned block, dirty if it was modified
+        void unpinBlock(int blockNum, bool dirty);
+
+        //write all dirty frames back to the block file
+        void flushAll();
+
+        int getNumFrames();
+
+        int getHits();
+
+        int getMisses();
+
+        int getPhysicalReads();
+
+        int getPhysicalWrites();
+
+        void resetStats();
+};
+
+#endif
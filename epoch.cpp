@@ -0,0 +1,75 @@
+#include "epoch.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+//EpochManager Constructor
+EpochManager::EpochManager(){
+    __globalEpoch = 1;
+    for (int i = 0; i < EPOCH_MAX_READERS; i++){
+        __readerEpochs[i] = 0;
+    }
+}
+
+//EpochManager Destructor
+EpochManager::~EpochManager(){
+    for (size_t i = 0; i < __retired.size(); i++){
+        __retired[i].second();
+    }
+}
+
+//Publish the current epoch in a free slot, each thread starts looking at its own slot
+int EpochManager::enter(){
+    static atomic<int> nextSlot(0);
+    thread_local int firstSlot = nextSlot++ % EPOCH_MAX_READERS;
+
+    uint64_t epoch = __globalEpoch.load();
+    for (int i = 0; ; i = (i + 1) % EPOCH_MAX_READERS){
+        int slot = (firstSlot + i) % EPOCH_MAX_READERS;
+        uint64_t expected = 0;
+        if (__readerEpochs[slot].compare_exchange_strong(expected, epoch)){
+            return slot;
+        }
+    }
+}
+
+void EpochManager::exit(int slot){
+    __readerEpochs[slot].store(0, memory_order_release);
+}
+
+//Tag release with the current epoch and start a new one, readers entering from now on cannot reach the item
+void EpochManager::retire(function<void()> release){
+    __retired.push_back(make_pair(__globalEpoch.fetch_add(1), release));
+}
+
+void EpochManager::reclaim(){
+    if (__retired.empty()){
+        return;
+    }
+
+    //oldest epoch a reader is still inside
+    uint64_t minEpoch = __globalEpoch.load();
+    for (int i = 0; i < EPOCH_MAX_READERS; i++){
+        uint64_t epoch = __readerEpochs[i].load();
+        if (epoch != 0 && epoch < minEpoch){
+            minEpoch = epoch;
+        }
+    }
+
+    //items are retired in epoch order
+    size_t numFreed = 0;
+    while (numFreed < __retired.size() && __retired[numFreed].first < minEpoch){
+        __retired[numFreed].second();
+        numFreed++;
+    }
+    __retired.erase(__retired.begin(), __retired.begin() + numFreed);
+}
+
+int EpochManager::getNumRetired(){
+    return __retired.size();
+}
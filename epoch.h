@@ -0,0 +1,45 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+#define EPOCH_MAX_READERS 256  // readers that can be inside at the same time
+
+// Defers freeing memory a writer unlinked until no reader can still be reading it.
+// Readers announce the epoch they started in, a retired item is freed once
+// every reader inside started after it was retired.
+class EpochManager {
+    private:
+        atomic<uint64_t> __globalEpoch;
+        atomic<uint64_t> __readerEpochs[EPOCH_MAX_READERS]; //0 while a slot is free
+        vector<pair<uint64_t, function<void()>>> __retired; //frees waiting for readers, writer only
+
+    public:
+        //constructor
+        EpochManager();
+
+        //destructor, runs every retired free, no reader may be inside
+        ~EpochManager();
+
+        //start reading, returns the slot to pass to exit
+        int enter();
+
+        //done reading
+        void exit(int slot);
+
+        //run release once current readers are done, called by the writer only
+        void retire(function<void()> release);
+
+        //run the frees no reader can be waiting on, called by the writer only
+        void reclaim();
+
+        int getNumRetired();
+};
+
+#endif
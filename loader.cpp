@@ -0,0 +1,202 @@
+#include "loader.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "parallel.h"
+#include "storage.h"
+
+typedef unsigned char uchar;
+
+using namespace std;
+
+// Find next tab or newline, 16 bytes at a time when SSE2 is available
+const char *findDelimiter(const char *cur, const char *end) {
+#ifdef __SSE2__
+    const __m128i tabs = _mm_set1_epi8('\t');
+    const __m128i newlines = _mm_set1_epi8('\n');
+    while (end - cur >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)cur);
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, tabs), _mm_cmpeq_epi8(chunk, newlines)));
+        if (mask != 0) {
+            return cur + __builtin_ctz(mask);
+        }
+        cur += 16;
+    }
+#endif
+    while (cur < end && *cur != '\t' && *cur != '\n') {
+        cur++;
+    }
+    return cur;
+}
+
+// Parse an unsigned integer field
+static int parseInt(const char *cur, const char *end) {
+    int value = 0;
+    while (cur < end && *cur >= '0' && *cur <= '9') {
+        value = value * 10 + (*cur - '0');
+        cur++;
+    }
+    return value;
+}
+
+// Parse a decimal field like "7.5", exact for the few fraction digits in the data
+static float parseFloat(const char *cur, const char *end) {
+    static const double powersOf10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+    bool negative = (cur < end && *cur == '-');
+    if (negative) {
+        cur++;
+    }
+    long long mantissa = 0;
+    int fractionDigits = 0;
+    bool fraction = false;
+    for (; cur < end; cur++) {
+        if (*cur >= '0' && *cur <= '9') {
+            if (fractionDigits < 9) {
+                mantissa = mantissa * 10 + (*cur - '0');
+                fractionDigits += fraction;
+            }
+        } else if (*cur == '.' && !fraction) {
+            fraction = true;
+        } else {
+            break;
+        }
+    }
+    double value = mantissa / powersOf10[fractionDigits];
+    return (float)(negative ? -value : value);
+}
+
+// Split the line starting at cur at its two tabs, false if it is not a record line
+static bool splitLine(const char *cur, const char *end, const char *&tab1, const char *&tab2, const char *&lineEnd) {
+    tab1 = findDelimiter(cur, end);
+    if (tab1 == end || *tab1 != '\t') {  // blank or malformed line
+        lineEnd = tab1;
+        return false;
+    }
+    tab2 = findDelimiter(tab1 + 1, end);
+    if (tab2 == end || *tab2 != '\t') {
+        lineEnd = tab2;
+        return false;
+    }
+    lineEnd = findDelimiter(tab2 + 1, end);
+    return true;
+}
+
+// Write the fields of a split line into record, a tconst too long for it is rejected
+static void parseRecord(const char *cur, const char *tab1, const char *tab2, const char *lineEnd, Record *record) {
+    int tconstLength = tab1 - cur;
+    if (tconstLength > (int)sizeof(record->tconst) - 1) {
+        throw logic_error("tconst " + string(cur, tconstLength) + " is longer than " + to_string(sizeof(record->tconst) - 1) + " characters");
+    }
+    memcpy(record->tconst, cur, tconstLength);
+    record->tconst[tconstLength] = '\0';
+    record->averageRating = parseFloat(tab1 + 1, tab2);
+    record->numVotes = parseInt(tab2 + 1, lineEnd);
+}
+
+// Parse a split line and check it fits the records of storage, throws before any storage is taken for it
+static void checkRecord(const char *cur, const char *tab1, const char *tab2, const char *lineEnd, Storage &storage, Record *record) {
+    parseRecord(cur, tab1, tab2, lineEnd, record);
+    if (storage.getRecordEncoding() == COMPACT_RECORDS) {
+        Storage::encodeRecord(*record);
+    }
+}
+
+// Start of the line after the header line
+static const char *skipHeader(const char *data, const char *end) {
+    const char *lineEnd = (const char *)memchr(data, '\n', end - data);
+    return (lineEnd == nullptr) ? end : lineEnd + 1;
+}
+
+// Parse records straight into Storage blocks
+int loadRecords(const char *data, long long size, Storage &storage, vector<RID> &dataEntries) {
+    const char *end = data + size;
+    const char *cur = skipHeader(data, end);
+    const char *tab1, *tab2, *lineEnd;
+    int numRecords = 0;
+
+    while (cur < end) {
+        if (splitLine(cur, end, tab1, tab2, lineEnd)) {
+            Record record;
+            checkRecord(cur, tab1, tab2, lineEnd, storage, &record);
+            RID rid = storage.addRecord(sizeof(Record));
+            storage.writeRecord(rid, record);
+            dataEntries.push_back(rid);
+            numRecords++;
+        }
+        cur = (lineEnd == end) ? end : lineEnd + 1;
+    }
+    return numRecords;
+}
+
+// Parse newline-aligned chunks on separate threads
+int loadRecordsParallel(const char *data, long long size, Storage &storage, vector<RID> &dataEntries, int numThreads) {
+    const char *end = data + size;
+    const char *start = skipHeader(data, end);
+
+    // chunk boundaries, moved forward to the start of the next line
+    int numChunks = numThreads * 4;
+    vector<const char *> bounds;
+    bounds.push_back(start);
+    for (int c = 1; c < numChunks; c++) {
+        const char *bound = start + (end - start) * c / numChunks;
+        if (bound < bounds.back()) {
+            bound = bounds.back();
+        }
+        const char *lineEnd = (const char *)memchr(bound, '\n', end - bound);
+        bounds.push_back((lineEnd == nullptr) ? end : lineEnd + 1);
+    }
+    bounds.push_back(end);
+
+    // first pass counts records of each chunk, a bad record throws here before anything is reserved
+    vector<int> chunkRecords(numChunks, 0);
+    parallelFor(numChunks, numThreads, [&](int c) {
+        const char *cur = bounds[c];
+        const char *tab1, *tab2, *lineEnd;
+        while (cur < bounds[c + 1]) {
+            if (splitLine(cur, end, tab1, tab2, lineEnd)) {
+                Record record;
+                checkRecord(cur, tab1, tab2, lineEnd, storage, &record);
+                chunkRecords[c]++;
+            }
+            cur = (lineEnd == end) ? end : lineEnd + 1;
+        }
+    });
+
+    // reserve records of each chunk in file order, giving the same layout as loadRecords
+    vector<RID> chunkStarts;
+    vector<size_t> chunkEntries;
+    size_t firstEntry = dataEntries.size();
+    size_t numEntries = firstEntry;
+    for (int c = 0; c < numChunks; c++) {
+        chunkStarts.push_back(storage.reserveRecords(chunkRecords[c], sizeof(Record)));
+        chunkEntries.push_back(numEntries);
+        numEntries += chunkRecords[c];
+    }
+    dataEntries.resize(numEntries);
+
+    // second pass parses each chunk into its reserved records
+    parallelFor(numChunks, numThreads, [&](int c) {
+        RID rid = chunkStarts[c];
+        size_t entry = chunkEntries[c];
+        const char *cur = bounds[c];
+        const char *tab1, *tab2, *lineEnd;
+        while (cur < bounds[c + 1]) {
+            if (splitLine(cur, end, tab1, tab2, lineEnd)) {
+                Record record;
+                parseRecord(cur, tab1, tab2, lineEnd, &record);
+                storage.writeRecord(rid, record);  // records of a PAX block are split over its minipages
+                dataEntries[entry++] = rid;
+                rid = storage.getNextRID(rid, sizeof(Record));
+            }
+            cur = (lineEnd == end) ? end : lineEnd + 1;
+        }
+    });
+    return numEntries - firstEntry;
+}
@@ -0,0 +1,25 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <vector>
+
+#include "rid.h"
+#include "storage.h"
+
+typedef unsigned char uchar;
+
+using namespace std;
+
+// find next tab or newline in [cur, end), end if there is none
+const char *findDelimiter(const char *cur, const char *end);
+
+// parse lines "tconst\taverageRating\tnumVotes" from a mapped TSV (header line included)
+// straight into Storage blocks, appending their RIDs to dataEntries, returns num of records read;
+// throws logic_error at a record the storage cannot hold, e.g. a tconst over 9 characters
+int loadRecords(const char *data, long long size, Storage &storage, vector<RID> &dataEntries);
+
+// same as loadRecords, with newline-aligned chunks parsed by numThreads threads;
+// every record is checked before any is stored, so a throw leaves storage unchanged
+int loadRecordsParallel(const char *data, long long size, Storage &storage, vector<RID> &dataEntries, int numThreads);
+
+#endif
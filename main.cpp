@@ -1,112 +1,97 @@
-#include <cmath>
-#include <cstring>
-#include <filesystem>
-#include <fstream>
 #include <iostream>
-#include <sstream>
+#include <stdexcept>
+#include <string>
 #include <tuple>
-#include <unordered_map>
 
 #include "bptree.h"
+#include "bufferpool.h"
+#include "loader.h"
+#include "mappedfile.h"
+#include "parallel.h"
 #include "storage.h"
 
 typedef unsigned char uchar;
-void *startAddress = NULL;
 
 using namespace std;
 
 int main() {
-    // Read data file
-    std::ifstream dataStream;
-    dataStream.open("data.tsv");
-
-    if (dataStream.is_open()) {
-
-        cout << "File opened" << endl;
-
-        // init Storage
-        int storageCapacity = 100000000;
-        int blockCapacity;
-
-        cout << "Enter Block Size (in Bytes)" << endl;
-        cin >> blockCapacity;
-
-        Storage storage(storageCapacity, blockCapacity);
-
-        vector<tuple<void *, int>> dataEntries;  // vector to hold read data
-
-        string line;
-        getline(dataStream, line);  // removing header line
-        cout << "Reading data ........" << endl;
-
-        // reading data entries
-        int count = 0;
-        int count2 = 0;
-
-        while (getline(dataStream, line)) {
+    // init Storage
+    long long storageCapacity = 0;  // grow extent by extent, up to the blocks a RID addresses
+    int blockCapacity;
+    int bufferFrames = 64;  // num of frames in the buffer pool used by the queries
+    BlockFormat blockFormat = ROW_BLOCKS;  // PAX_BLOCKS keeps each field of the records of a block together,
+                                           // COMPRESSED_BLOCKS compresses blocks once the index is built
+    RecordEncoding recordEncoding = FULL_RECORDS;  // COMPACT_RECORDS stores records in 10 bytes instead of 20
+
+    cout << "Enter Block Size (in Bytes)" << endl;
+    cin >> blockCapacity;
+
+    // Storage is backed by a block file, reopened if a previous run created it
+    string blockFilename = "data_" + to_string(blockCapacity) + "B.db";
+    Storage storage(blockFilename, storageCapacity, blockCapacity, blockFormat, recordEncoding);
+
+    // Map data file only if there are no stored records
+    MappedFile dataFile;
+    if (storage.getNumRecords() == 0) {
+        dataFile.open("data.tsv", 0, false);
+    }
 
-            Record record;
-            istringstream isStream(line);
+    if (storage.getNumRecords() > 0 || dataFile.isOpen()) {
 
-            // convert tconst from string to200 char[]
-            string tconstStr;
-            getline(isStream, tconstStr, '\t');
-            strcpy(record.tconst, tconstStr.c_str());
+        vector<RID> dataEntries;  // RIDs of the records read
 
-            // process remaining fields
-            isStream >> record.averageRating;
-            isStream >> record.numVotes;
+        if (storage.getNumRecords() > 0) {
+            cout << "Block file " << blockFilename << " reopened" << endl;
 
-            tuple<void *, int> dataEntry = storage.addRecord(sizeof(record));
+            storage.getRIDs(dataEntries);
+        } else {
+            cout << "File opened" << endl;
 
-            dataEntries.push_back(dataEntry);
+            cout << "Reading data ........" << endl;
 
-            void *rcdAdr = (uchar *)get<0>(dataEntry) + get<1>(dataEntry);
-          
-            memcpy(rcdAdr, &record, sizeof(record));
+            // parse chunks of the mapped file straight into storage blocks on all cores
+            try {
+                loadRecordsParallel((const char *)dataFile.getData(), dataFile.getSize(), storage, dataEntries, getNumThreads());
+            } catch (const logic_error &error) {
+                cout << "Error reading data.tsv: " << error.what() << endl;
+                return 1;
+            }
+            dataFile.close();
+            storage.flush();
         }
-        // end of reading
-        dataStream.close();
 
         // Experiment 1 - Storage Statistic
         cout << "============= Experiment 1 : Storage Statistics =============" << endl;
         cout << endl;
-        cout << "Total Storage Size (MegaBytes) : " << storage.getStorageCapacity() / 1000000 << endl;
+        cout << "Total Storage Size (MegaBytes) : " << storage.getStorageSizeAllocated() / 1000000 << endl;
         cout << "Total Number of Records \t: " << storage.getNumRecords() << endl;
         cout << "Total Size of Records (Bytes) \t: " << storage.getStorageSizeUsed() << endl;
         cout << endl;
         cout << "Capacity of a Block (Bytes) \t: " << storage.getBlockCapacity() << endl;
-        cout << "Max Record per Block \t\t: " << floor(storage.getBlockCapacity() / sizeof(Record)) << endl;
+        if (storage.getBlockFormat() == COMPRESSED_BLOCKS) {
+            cout << "Max Record per Block \t\t: depends on the data, " << storage.getMaxRecordsPerBlock() << " uncompressed" << endl;
+        } else {
+            cout << "Max Record per Block \t\t: " << storage.getMaxRecordsPerBlock() << endl;
+        }
         cout << "Number of Blocks Allocated \t: " << storage.getBlocksUsed()<< endl;
         cout << "Max Number of Blocks \t\t: " << storage.getStorageCapacity() / storage.getBlockCapacity() << endl;
         cout << "============================================================="<< endl;
         cout << endl;
 
         // Experiment 2 - B+ Tree Indexing Component
-        BPTree bptree(storage.getBlockCapacity());
-        int i = 1;
-        
-        vector<tuple<void *, int>>::iterator entriesIterator;
-
-        for (entriesIterator = dataEntries.begin();
-             entriesIterator != dataEntries.end(); ++entriesIterator) {
-            
-            void *blockAddress = get<0>(*entriesIterator);
-            int offset = get<1>(*entriesIterator);
-
-            if (startAddress == NULL) {
-                startAddress = blockAddress;
-            }
-
-            
-            void *entryAddress = (uchar *)blockAddress + offset;
-           
-            int votes = (*(Record *)entryAddress).numVotes;
-
-            Key newKey;
-            newKey.key_value = votes;
-            newKey.address.push_back(entryAddress);
-            bptree.insert(newKey);
+        BPTree bptree(&storage);
+        float fillFactor = 1.0;  // fraction of each node filled by the bulk load
+        bool clusterStorage = false;  // lay records out in numVotes order so key ranges read contiguous blocks
+
+        // build the index bottom-up instead of inserting record by record
+        bptree.bulkLoad(dataEntries, fillFactor);
+        if (clusterStorage) {
+            bptree.cluster();
+            storage.flush();
+        } else if (storage.getBlockFormat() == COMPRESSED_BLOCKS) {
+            // records are loaded whole, blocks are compressed by rewriting them in file order
+            bptree.compress();
+            storage.flush();
         }
 
         std::cout << "============= Experiment 2 : B+ Tree Statistics =============" << endl;
@@ -118,6 +103,13 @@ int main() {
         cout << "=============================================================" << endl;
         cout << endl;
 
+        // data blocks of the queries are read from the block file through a buffer pool
+        BufferPool *bufferPool = nullptr;
+        if (storage.isPersistent()) {
+            storage.flush();
+            bufferPool = new BufferPool(blockFilename, blockCapacity, bufferFrames);
+        }
+
         // Experiment 3 - Search Query
         string filename;
         std::cout << "============= Experiment 3: Retrieve movies with numVotes = 500 =============" << endl;
@@ -128,11 +120,18 @@ int main() {
             filename = "Exp3Results_500B";
         }
 
-        tuple<int, int, float> finalResults = bptree.searchExp(500, 500, filename);
+        if (bufferPool != nullptr) {
+            bufferPool->resetStats();
+        }
+        tuple<int, int, float> finalResults = bptree.searchExp(500, 500, filename, bufferPool);
         std::cout << endl;
         std::cout << "Number of index nodes the process accessed: " << get<0>(finalResults) << endl;
         std::cout << "Number of data blocks the process accessed: " << get<1>(finalResults) << endl;
         std::cout << "Average Rating of all records returned : " << get<2>(finalResults) << endl;
+        if (bufferPool != nullptr) {
+            std::cout << "Buffer pool hits / misses (" << bufferPool->getNumFrames() << " frames) : " << bufferPool->getHits() << " / " << bufferPool->getMisses() << endl;
+            std::cout << "Number of data blocks physically read: " << bufferPool->getPhysicalReads() << endl;
+        }
         std::cout << "=============================================================" << endl;
         cout << endl;
 
@@ -145,14 +144,23 @@ int main() {
             filename = "Exp4Results_500B";
         }
 
-        finalResults = bptree.searchExp(30000, 40000, filename);
+        if (bufferPool != nullptr) {
+            bufferPool->resetStats();
+        }
+        finalResults = bptree.searchExp(30000, 40000, filename, bufferPool);
         std::cout << endl;
         std::cout << "Number of index nodes the process accessed: " << get<0>(finalResults) << endl;
         std::cout << "Number of data blocks the process accessed: " << get<1>(finalResults) << endl;
         std::cout << "Average Rating of all records returned : " << get<2>(finalResults) << endl;
+        if (bufferPool != nullptr) {
+            std::cout << "Buffer pool hits / misses (" << bufferPool->getNumFrames() << " frames) : " << bufferPool->getHits() << " / " << bufferPool->getMisses() << endl;
+            std::cout << "Number of data blocks physically read: " << bufferPool->getPhysicalReads() << endl;
+        }
         std::cout << "=============================================================" << endl;
         std::cout << endl;
 
+        delete bufferPool;
+
         // Experiment 5 - Record deletions
         cout << "============== Experiment 5 : Record deletions ==============" << endl;
         std::cout << endl;
@@ -0,0 +1,201 @@
+#include "mappedfile.h"
+
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+typedef unsigned char uchar;
+
+using namespace std;
+
+//MappedFile Constructor
+MappedFile::MappedFile(){
+    __data = nullptr;
+    __size = 0;
+    __mapBase = nullptr;
+    __mapSize = 0;
+    __writable = false;
+#ifdef _WIN32
+    __fileHandle = INVALID_HANDLE_VALUE;
+    __mappingHandle = NULL;
+#else
+    __fd = -1;
+#endif
+}
+
+//MappedFile Destructor
+MappedFile::~MappedFile(){
+    close();
+}
+
+#ifdef _WIN32
+
+//Map size bytes of the file from offset, growing the file if needed
+bool MappedFile::open(string filename, long long size, bool writable, long long offset){
+    close();
+
+    DWORD access = writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ;
+    DWORD disposition = writable ? OPEN_ALWAYS : OPEN_EXISTING;
+    __fileHandle = CreateFileA(filename.c_str(), access, FILE_SHARE_READ, NULL, disposition, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (__fileHandle == INVALID_HANDLE_VALUE){
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(__fileHandle, &fileSize);
+    if (size == 0){ //rest of the file
+        size = fileSize.QuadPart - offset;
+    }
+    if (writable && offset + size > fileSize.QuadPart){ //extend file to the end of the range
+        fileSize.QuadPart = offset + size;
+        SetFilePointerEx(__fileHandle, fileSize, NULL, FILE_BEGIN);
+        SetEndOfFile(__fileHandle);
+    }
+    if (size <= 0 || offset + size > fileSize.QuadPart){ //empty ranges cannot be mapped
+        close();
+        return false;
+    }
+
+    __mappingHandle = CreateFileMappingA(__fileHandle, NULL, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, NULL);
+    if (__mappingHandle == NULL){
+        close();
+        return false;
+    }
+
+    //views start at a multiple of the allocation granularity
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    long long mapOffset = offset / systemInfo.dwAllocationGranularity * systemInfo.dwAllocationGranularity;
+    long long mapSize = size + (offset - mapOffset);
+    __mapBase = (uchar *) MapViewOfFile(__mappingHandle, writable ? FILE_MAP_WRITE : FILE_MAP_READ,
+                                        (DWORD)(mapOffset >> 32), (DWORD)(mapOffset & 0xffffffff), (SIZE_T) mapSize);
+    if (__mapBase == NULL){
+        __mapBase = nullptr;
+        close();
+        return false;
+    }
+    __mapSize = mapSize;
+    __data = __mapBase + (offset - mapOffset);
+    __size = size;
+    __writable = writable;
+    return true;
+}
+
+//Flush dirty pages of the mapping to disk
+void MappedFile::sync(){
+    if (__data != nullptr && __writable){
+        FlushViewOfFile(__mapBase, 0);
+        FlushFileBuffers(__fileHandle);
+    }
+}
+
+//Unmap and close the file
+void MappedFile::close(){
+    if (__mapBase != nullptr){
+        UnmapViewOfFile(__mapBase);
+        __mapBase = nullptr;
+        __data = nullptr;
+    }
+    if (__mappingHandle != NULL){
+        CloseHandle(__mappingHandle);
+        __mappingHandle = NULL;
+    }
+    if (__fileHandle != INVALID_HANDLE_VALUE){
+        CloseHandle(__fileHandle);
+        __fileHandle = INVALID_HANDLE_VALUE;
+    }
+    __size = 0;
+    __mapSize = 0;
+}
+
+#else
+
+//Map size bytes of the file from offset, growing the file if needed
+bool MappedFile::open(string filename, long long size, bool writable, long long offset){
+    close();
+
+    __fd = ::open(filename.c_str(), writable ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+    if (__fd < 0){
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(__fd, &fileStat) != 0){
+        close();
+        return false;
+    }
+    long long fileSize = fileStat.st_size;
+    if (size == 0){ //rest of the file
+        size = fileSize - offset;
+    }
+    if (writable && offset + size > fileSize){ //extend file to the end of the range, new pages read as zero
+        if (ftruncate(__fd, offset + size) != 0){
+            close();
+            return false;
+        }
+        fileSize = offset + size;
+    }
+    if (size <= 0 || offset + size > fileSize){ //empty ranges cannot be mapped
+        close();
+        return false;
+    }
+
+    //mappings start at a page boundary
+    long long pageSize = sysconf(_SC_PAGESIZE);
+    long long mapOffset = offset / pageSize * pageSize;
+    long long mapSize = size + (offset - mapOffset);
+    void *addr = mmap(nullptr, mapSize, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, __fd, mapOffset);
+    if (addr == MAP_FAILED){
+        close();
+        return false;
+    }
+    __mapBase = (uchar *) addr;
+    __mapSize = mapSize;
+    __data = __mapBase + (offset - mapOffset);
+    __size = size;
+    __writable = writable;
+    return true;
+}
+
+//Flush dirty pages of the mapping to disk
+void MappedFile::sync(){
+    if (__data != nullptr && __writable){
+        msync(__mapBase, __mapSize, MS_SYNC);
+    }
+}
+
+//Unmap and close the file
+void MappedFile::close(){
+    if (__mapBase != nullptr){
+        munmap(__mapBase, __mapSize);
+        __mapBase = nullptr;
+        __data = nullptr;
+    }
+    if (__fd >= 0){
+        ::close(__fd);
+        __fd = -1;
+    }
+    __size = 0;
+    __mapSize = 0;
+}
+
+#endif
+
+bool MappedFile::isOpen(){
+    return __data != nullptr;
+}
+
+uchar *MappedFile::getData(){
+    return __data;
+}
+
+long long MappedFile::getSize(){
+    return __size;
+}
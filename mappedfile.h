@@ -0,0 +1,50 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+
+typedef unsigned char uchar;
+
+using namespace std;
+
+// Memory-mapped view of a file or of a range of it
+class MappedFile {
+    private:
+        uchar *__data; //start of the mapped range
+        long long __size; //size of the mapped range in bytes
+        uchar *__mapBase; //start of the mapping, __data rounded down to the mapping granularity
+        long long __mapSize; //size of the mapping from __mapBase
+        bool __writable; //mapping is shared read/write
+
+#ifdef _WIN32
+        void *__fileHandle;
+        void *__mappingHandle;
+#else
+        int __fd;
+#endif
+
+    public:
+        //constructor
+        MappedFile();
+
+        //destructor
+        ~MappedFile();
+
+        //map size bytes of filename from offset, creating or extending the file when writable
+        //size 0 maps the rest of the file
+        bool open(string filename, long long size, bool writable, long long offset = 0);
+
+        //write dirty pages back to the file
+        void sync();
+
+        //unmap and close the file
+        void close();
+
+        bool isOpen();
+
+        uchar *getData();
+
+        long long getSize();
+};
+
+#endif
@@ -0,0 +1,70 @@
+#include "nodearena.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+typedef unsigned char uchar;
+
+using namespace std;
+
+#define CACHE_LINE_SIZE 64
+
+//NodeArena Constructor
+NodeArena::NodeArena(int nodeBytes, int nodesPerChunk){
+    __nodeBytes = (nodeBytes + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE; //keep every node on its own cache lines
+    __nodesPerChunk = nodesPerChunk;
+    __next = nullptr;
+    __nodesLeft = 0;
+    __numNodes = 0;
+}
+
+//NodeArena Destructor
+NodeArena::~NodeArena(){
+    for (size_t i = 0; i < __chunks.size(); i++){
+        delete[] __chunks[i];
+    }
+    __chunks.clear();
+}
+
+//Get the next node buffer, allocating a new chunk when the last one is used up
+void *NodeArena::allocate(){
+    if (!__freeNodes.empty()){
+        void *node = __freeNodes.back();
+        __freeNodes.pop_back();
+        memset(node, 0, __nodeBytes);
+        __numNodes++;
+        return node;
+    }
+
+    if (__nodesLeft == 0){
+        long long chunkBytes = (long long) __nodeBytes * __nodesPerChunk + CACHE_LINE_SIZE;
+        uchar *chunk = new uchar[chunkBytes];
+        __chunks.push_back(chunk);
+
+        uintptr_t aligned = ((uintptr_t) chunk + CACHE_LINE_SIZE - 1) & ~(uintptr_t)(CACHE_LINE_SIZE - 1);
+        __next = (uchar *) aligned;
+        __nodesLeft = __nodesPerChunk;
+    }
+
+    void *node = __next;
+    memset(node, 0, __nodeBytes);
+    __next += __nodeBytes;
+    __nodesLeft--;
+    __numNodes++;
+    return node;
+}
+
+//Keep a released buffer for the next allocate, chunks are only freed with the arena
+void NodeArena::release(void *node){
+    __freeNodes.push_back(node);
+    __numNodes--;
+}
+
+int NodeArena::getNodeBytes(){
+    return __nodeBytes;
+}
+
+int NodeArena::getNumNodes(){
+    return __numNodes;
+}
@@ -0,0 +1,39 @@
+#ifndef NODEARENA_H
+#define NODEARENA_H
+
+#include <vector>
+
+typedef unsigned char uchar;
+
+using namespace std;
+
+// Hands out fixed-size, cache-line aligned node buffers carved from large chunks
+class NodeArena {
+    private:
+        int __nodeBytes; //size of one node buffer
+        int __nodesPerChunk; //num of node buffers in a chunk
+        vector<uchar *> __chunks; //allocated chunks
+        vector<void *> __freeNodes; //released buffers, reused first
+        uchar *__next; //next free buffer in the last chunk
+        int __nodesLeft; //num of free buffers left in the last chunk
+        int __numNodes; //num of buffers in use
+
+    public:
+        //constructor
+        NodeArena(int nodeBytes, int nodesPerChunk);
+
+        //destructor, frees every node buffer
+        ~NodeArena();
+
+        //get a zeroed node buffer
+        void *allocate();
+
+        //give back a buffer of a node that left the tree
+        void release(void *node);
+
+        int getNodeBytes();
+
+        int getNumNodes();
+};
+
+#endif
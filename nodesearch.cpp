@@ -0,0 +1,144 @@
+#include "nodesearch.h"
+
+#include "shared.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define NODE_SEARCH_AVX2
+#endif
+
+static NodeSearchMode searchMode = NODE_SEARCH_DEFAULT;
+
+#ifdef NODE_SEARCH_AVX2
+// Check once if the CPU runs AVX2
+static bool hasAvx2() {
+    static bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+// Count keys <= key (upper) or < key (lower), 8 keys per compare
+__attribute__((target("avx2"))) static int simdCount(const int *keys, int numKeys, int key, bool upper) {
+    __m256i target = _mm256_set1_epi32(key);
+    int count = 0;
+    int i = 0;
+    for (; i + 8 <= numKeys; i += 8) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(keys + i));
+        // upper: lanes with keys[i] > key fail, lower: lanes with keys[i] >= key fail
+        __m256i fail = upper ? _mm256_cmpgt_epi32(block, target)
+                             : _mm256_or_si256(_mm256_cmpgt_epi32(block, target), _mm256_cmpeq_epi32(block, target));
+        int failMask = _mm256_movemask_ps(_mm256_castsi256_ps(fail));
+        count += 8 - __builtin_popcount(failMask);
+        if (failMask != 0) {  // keys are sorted, the rest are larger
+            return count;
+        }
+    }
+    for (; i < numKeys; i++) {
+        if (upper ? keys[i] > key : keys[i] >= key) {
+            break;
+        }
+        count++;
+    }
+    return count;
+}
+#endif
+
+void setNodeSearchMode(NodeSearchMode mode) {
+    searchMode = mode;
+}
+
+NodeSearchMode getNodeSearchMode() {
+    return searchMode;
+}
+
+int upperBound(const int *keys, int numKeys, int key) {
+    if (numKeys <= 0) {
+        return 0;
+    }
+    switch (searchMode) {
+        case LINEAR_SEARCH: {
+            int i = 0;
+            while (i < numKeys && keys[i] <= key) {
+                i++;
+            }
+            return i;
+        }
+#ifdef NODE_SEARCH_AVX2
+        case SIMD_SEARCH:
+            if (hasAvx2()) {
+                return simdCount(keys, numKeys, key, true);
+            }
+            [[fallthrough]];
+#endif
+        default: {
+            // halve the range without branching on the comparison
+            const int *base = keys;
+            int len = numKeys;
+            while (len > 1) {
+                int half = len / 2;
+                base += (base[half] <= key) * half;
+                len -= half;
+            }
+            return (base - keys) + (*base <= key);
+        }
+    }
+}
+
+int lowerBound(const int *keys, int numKeys, int key) {
+    if (numKeys <= 0) {
+        return 0;
+    }
+    switch (searchMode) {
+        case LINEAR_SEARCH: {
+            int i = 0;
+            while (i < numKeys && keys[i] < key) {
+                i++;
+            }
+            return i;
+        }
+#ifdef NODE_SEARCH_AVX2
+        case SIMD_SEARCH:
+            if (hasAvx2()) {
+                return simdCount(keys, numKeys, key, false);
+            }
+            [[fallthrough]];
+#endif
+        default: {
+            const int *base = keys;
+            int len = numKeys;
+            while (len > 1) {
+                int half = len / 2;
+                base += (base[half] < key) * half;
+                len -= half;
+            }
+            return (base - keys) + (*base < key);
+        }
+    }
+}
+
+int upperBoundShared(const int *keys, int numKeys, int key) {
+    if (numKeys <= 0) {
+        return 0;
+    }
+    const int *base = keys;
+    int len = numKeys;
+    while (len > 1) {
+        int half = len / 2;
+        base += (loadRelaxed(base[half]) <= key) * half;
+        len -= half;
+    }
+    return (base - keys) + (loadRelaxed(*base) <= key);
+}
+
+int lowerBoundShared(const int *keys, int numKeys, int key) {
+    if (numKeys <= 0) {
+        return 0;
+    }
+    const int *base = keys;
+    int len = numKeys;
+    while (len > 1) {
+        int half = len / 2;
+        base += (loadRelaxed(base[half]) < key) * half;
+        len -= half;
+    }
+    return (base - keys) + (loadRelaxed(*base) < key);
+}
@@ -0,0 +1,33 @@
+#ifndef NODESEARCH_H
+#define NODESEARCH_H
+
+// Kernels used to find a key among the sorted keys of a B+ tree node
+enum NodeSearchMode {
+    LINEAR_SEARCH,  // scan keys one by one
+    BINARY_SEARCH,  // branchless binary search
+    SIMD_SEARCH     // AVX2 compare of 8 keys at a time, binary search without AVX2
+};
+
+// mode used before setNodeSearchMode is called, can be set at build time
+#ifndef NODE_SEARCH_DEFAULT
+#define NODE_SEARCH_DEFAULT BINARY_SEARCH
+#endif
+
+// select kernel used by every node search
+void setNodeSearchMode(NodeSearchMode mode);
+
+NodeSearchMode getNodeSearchMode();
+
+// num of keys <= key, the index of the child to follow for key
+int upperBound(const int *keys, int numKeys, int key);
+
+// num of keys < key, the position of key in a node
+int lowerBound(const int *keys, int numKeys, int key);
+
+// upperBound and lowerBound by branchless binary search for keys a writer may change meanwhile,
+// every key is read atomically
+int upperBoundShared(const int *keys, int numKeys, int key);
+
+int lowerBoundShared(const int *keys, int numKeys, int key);
+
+#endif
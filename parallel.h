@@ -0,0 +1,108 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// num of hardware threads, at least 1
+inline int getNumThreads() {
+    int numThreads = thread::hardware_concurrency();
+    return numThreads > 0 ? numThreads : 1;
+}
+
+// run fn(i) for every i in [0, n), spread over up to numThreads threads;
+// an exception thrown by fn stops its thread and is rethrown once all threads joined
+template <typename Fn>
+void parallelFor(int n, int numThreads, Fn fn) {
+    if (numThreads > n) {
+        numThreads = n;
+    }
+    if (numThreads <= 1) {
+        for (int i = 0; i < n; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    vector<thread> workers;
+    vector<exception_ptr> errors(numThreads);
+    for (int t = 0; t < numThreads; t++) {
+        workers.push_back(thread([&fn, &errors, n, numThreads, t]() {
+            try {
+                for (int i = t; i < n; i += numThreads) {
+                    fn(i);
+                }
+            } catch (...) {
+                errors[t] = current_exception();
+            }
+        }));
+    }
+    for (int t = 0; t < numThreads; t++) {
+        workers[t].join();
+    }
+    for (int t = 0; t < numThreads; t++) {
+        if (errors[t]) {
+            rethrow_exception(errors[t]);
+        }
+    }
+}
+
+// stable LSD radix sort on an unsigned 32-bit key, 8 bits per pass;
+// each thread histograms and scatters its own contiguous chunk
+template <typename T, typename KeyFn>
+void parallelRadixSort(vector<T> &items, KeyFn key, int numThreads) {
+    size_t n = items.size();
+    if (numThreads > (int)(n / 65536) + 1) {
+        numThreads = n / 65536 + 1;
+    }
+    vector<size_t> bounds;
+    for (int t = 0; t <= numThreads; t++) {
+        bounds.push_back(n * t / numThreads);
+    }
+
+    vector<T> buffer(n);
+    vector<size_t> counts(numThreads * 256);
+    for (int shift = 0; shift < 32; shift += 8) {
+        fill(counts.begin(), counts.end(), 0);
+        parallelFor(numThreads, numThreads, [&](int t) {
+            for (size_t i = bounds[t]; i < bounds[t + 1]; i++) {
+                counts[t * 256 + ((key(items[i]) >> shift) & 0xFF)]++;
+            }
+        });
+
+        // skip passes where every key has the same digit
+        bool sameDigit = false;
+        for (int d = 0; d < 256 && !sameDigit; d++) {
+            size_t total = 0;
+            for (int t = 0; t < numThreads; t++) {
+                total += counts[t * 256 + d];
+            }
+            sameDigit = (total == n);
+        }
+        if (sameDigit) {
+            continue;
+        }
+
+        // turn counts into start offsets, ordered by digit then by thread to stay stable
+        size_t offset = 0;
+        for (int d = 0; d < 256; d++) {
+            for (int t = 0; t < numThreads; t++) {
+                size_t count = counts[t * 256 + d];
+                counts[t * 256 + d] = offset;
+                offset += count;
+            }
+        }
+        parallelFor(numThreads, numThreads, [&](int t) {
+            for (size_t i = bounds[t]; i < bounds[t + 1]; i++) {
+                buffer[counts[t * 256 + ((key(items[i]) >> shift) & 0xFF)]++] = items[i];
+            }
+        });
+        items.swap(buffer);
+    }
+}
+
+#endif
@@ -0,0 +1,138 @@
+#include "posting.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+typedef unsigned char uchar;
+
+using namespace std;
+
+PostingList::PostingList() {
+    size = 0;
+    firstPage = nullptr;
+    lastPage = nullptr;
+    lastAddress = 0;
+}
+
+// Append an address, overflow addresses go to the last page
+void PostingList::append(RID address) {
+    // concurrent readers walk the list as it grows: an address is written before size or used
+    // covers it, a page is set up before it is linked
+    if (size < POSTING_INLINE_SIZE) {
+        inlineAddresses[size] = address;
+        storeRelease(size, size + 1);
+        lastAddress = address;
+        return;
+    }
+
+    // encode the entry before picking its page
+    uchar entry[16];
+    int entryBytes = 0;
+#if POSTING_DELTA_ENCODING
+    int64_t delta = (int64_t)address - (int64_t)lastAddress;
+    uint64_t zigzag = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+    do {
+        uchar byte = zigzag & 0x7F;
+        zigzag >>= 7;
+        entry[entryBytes++] = byte | (zigzag != 0 ? 0x80 : 0);
+    } while (zigzag != 0);
+#else
+    memcpy(entry, &address, sizeof(address));
+    entryBytes = sizeof(address);
+#endif
+
+    if (lastPage == nullptr || lastPage->used + entryBytes > POSTING_PAGE_BYTES) {
+        PostingPage *page = new PostingPage();
+        page->next = nullptr;
+        page->used = 0;
+        if (lastPage == nullptr) {
+            storeRelease(firstPage, page);
+        } else {
+            storeRelease(lastPage->next, page);
+        }
+        lastPage = page;
+    }
+    memcpy(lastPage->data + lastPage->used, entry, entryBytes);
+    storeRelease(lastPage->used, lastPage->used + entryBytes);
+    lastAddress = address;
+    storeRelease(size, size + 1);
+}
+
+// Add an address to a leaf slot, a second address moves the slot into a list
+void *PostingList::add(void *slot, RID address) {
+    if (slot == nullptr) {
+        return (void *)(((uintptr_t)address << 1) | 1);
+    }
+    PostingList *list;
+    if (isInline(slot)) {
+        list = new PostingList();
+        list->append((RID)((uintptr_t)slot >> 1));
+    } else {
+        list = (PostingList *)slot;
+    }
+    list->append(address);
+    return list;
+}
+
+int PostingList::count(void *slot) {
+    if (slot == nullptr) {
+        return 0;
+    }
+    if (isInline(slot)) {
+        return 1;
+    }
+    return ((PostingList *)slot)->size;
+}
+
+void PostingList::release(void *slot) {
+    if (slot == nullptr || isInline(slot)) {
+        return;
+    }
+    PostingList *list = (PostingList *)slot;
+    PostingPage *page = list->firstPage;
+    while (page != nullptr) {
+        PostingPage *next = page->next;
+        delete page;
+        page = next;
+    }
+    delete list;
+}
+
+void *PostingList::replace(void *slot, const RID *from, const RID *to, int n, uchar *replaced) {
+    int numReplaced = 0;
+    void *newSlot = nullptr;
+    forEach(slot, [&](RID address) {
+        int i = lower_bound(from, from + n, address) - from;
+        if (i < n && from[i] == address && !replaced[i]) {
+            replaced[i] = 1;
+            address = to[i];
+            numReplaced++;
+        }
+        newSlot = add(newSlot, address);
+    });
+    if (numReplaced == 0) {
+        release(newSlot);
+        return slot;
+    }
+    return newSlot;
+}
+
+long long PostingList::getBytes(void *slot) {
+    if (slot == nullptr || isInline(slot)) {
+        return 0;
+    }
+    long long bytes = sizeof(PostingList);
+    for (PostingPage *page = ((PostingList *)slot)->firstPage; page != nullptr; page = page->next) {
+        bytes += sizeof(PostingPage);
+    }
+    return bytes;
+}
+
+vector<RID> PostingList::getAddresses(void *slot) {
+    vector<RID> addresses;
+    addresses.reserve(count(slot));
+    forEach(slot, [&](RID address) { addresses.push_back(address); });
+    return addresses;
+}
@@ -0,0 +1,175 @@
+#ifndef POSTING_H
+#define POSTING_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "rid.h"
+#include "shared.h"
+
+typedef unsigned char uchar;
+
+using namespace std;
+
+#define POSTING_INLINE_SIZE 4     // RIDs kept in the list header
+#define POSTING_PAGE_BYTES 240    // payload of an overflow page
+
+// store overflow RIDs as zigzag varint deltas instead of raw RIDs
+#ifndef POSTING_DELTA_ENCODING
+#define POSTING_DELTA_ENCODING 1
+#endif
+
+// Overflow page of a posting list
+struct PostingPage {
+    PostingPage *next;
+    int used;  // bytes of data in use
+    uchar data[POSTING_PAGE_BYTES];
+};
+
+// Record IDs of one key in a leaf, called addresses below.
+// A leaf slot holds either a single RID tagged as (rid << 1) | 1,
+// or a pointer to a PostingList once the key has more than one record.
+class PostingList {
+   private:
+    int size;                              // num of addresses
+    RID inlineAddresses[POSTING_INLINE_SIZE];
+    PostingPage *firstPage;
+    PostingPage *lastPage;
+    RID lastAddress;                       // base of the next delta
+
+    PostingList();
+    friend class PostingCursor;
+
+    void append(RID address);
+
+    static bool isInline(void *slot) {
+        return ((uintptr_t)slot & 1) != 0;
+    }
+
+    // decode an overflow address at pos, moving pos past it
+    static RID readEntry(const uchar *data, int &pos, RID prevAddress) {
+#if POSTING_DELTA_ENCODING
+        uint64_t zigzag = 0;
+        int shift = 0;
+        uchar byte;
+        do {
+            byte = data[pos++];
+            zigzag |= (uint64_t)(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        int64_t delta = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+        return (RID)(prevAddress + delta);
+#else
+        RID address;
+        memcpy(&address, data + pos, sizeof(address));
+        pos += sizeof(address);
+        return address;
+#endif
+    }
+
+   public:
+    // add an address to a leaf slot (nullptr for a new key), returns the new slot value
+    static void *add(void *slot, RID address);
+
+    // num of addresses in a leaf slot
+    static int count(void *slot);
+
+    // free the list behind a leaf slot
+    static void release(void *slot);
+
+    // change each address from[i] (sorted) found in a leaf slot to to[i], setting replaced[i];
+    // returns slot if nothing was found, otherwise a new slot value and the caller releases the old one
+    static void *replace(void *slot, const RID *from, const RID *to, int n, uchar *replaced);
+
+    // bytes allocated for a leaf slot beyond the slot itself
+    static long long getBytes(void *slot);
+
+    // copy all addresses of a leaf slot
+    static vector<RID> getAddresses(void *slot);
+
+    // call fn(address) for each address of a leaf slot in insertion order
+    template <typename Fn>
+    static void forEach(void *slot, Fn fn) {
+        if (slot == nullptr) {
+            return;
+        }
+        if (isInline(slot)) {
+            fn((RID)((uintptr_t)slot >> 1));
+            return;
+        }
+        PostingList *list = (PostingList *)slot;
+        int numInline = list->size < POSTING_INLINE_SIZE ? list->size : POSTING_INLINE_SIZE;
+        for (int i = 0; i < numInline; i++) {
+            fn(list->inlineAddresses[i]);
+        }
+        RID prevAddress = list->inlineAddresses[POSTING_INLINE_SIZE - 1];
+        for (PostingPage *page = list->firstPage; page != nullptr; page = page->next) {
+            int pos = 0;
+            while (pos < page->used) {
+                prevAddress = readEntry(page->data, pos, prevAddress);
+                fn(prevAddress);
+            }
+        }
+    }
+};
+
+// Walks the addresses of a leaf slot one at a time without allocating,
+// safe while the writer of a concurrent tree appends to the list
+class PostingCursor {
+   private:
+    void *slot;             // nullptr once every address is returned
+    int index;              // next inline address
+    PostingPage *page;      // overflow page being read
+    int pos;                // byte position in page
+    RID prevAddress;        // base of the next delta
+
+   public:
+    PostingCursor() : slot(nullptr), index(0), page(nullptr), pos(0), prevAddress(0) {}
+
+    // start at the first address of a leaf slot
+    void reset(void *slot) {
+        this->slot = slot;
+        index = 0;
+        pos = 0;
+        page = nullptr;
+        if (slot != nullptr && !PostingList::isInline(slot)) {
+            // the inline addresses are full once there is an overflow page
+            PostingList *list = (PostingList *)slot;
+            page = loadAcquire(list->firstPage);
+            if (page != nullptr) {
+                prevAddress = list->inlineAddresses[POSTING_INLINE_SIZE - 1];
+            }
+        }
+    }
+
+    // get the next address in insertion order, false when there are no more
+    bool next(RID &address) {
+        if (slot == nullptr) {
+            return false;
+        }
+        if (PostingList::isInline(slot)) {
+            address = (RID)((uintptr_t)slot >> 1);
+            slot = nullptr;
+            return true;
+        }
+        PostingList *list = (PostingList *)slot;
+        if (index < POSTING_INLINE_SIZE && index < loadAcquire(list->size)) {
+            address = list->inlineAddresses[index++];
+            return true;
+        }
+        while (page != nullptr) {
+            if (pos < loadAcquire(page->used)) {
+                prevAddress = PostingList::readEntry(page->data, pos, prevAddress);
+                address = prevAddress;
+                return true;
+            }
+            page = loadAcquire(page->next);
+            pos = 0;
+        }
+        slot = nullptr;
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef RID_H
+#define RID_H
+
+#include <cstdint>
+
+using namespace std;
+
+// Record ID: block num in the high bits, slot of the record within the block in the low bits.
+// With 10 slot bits a RID addresses 4M blocks of up to 1024 records.
+typedef uint32_t RID;
+
+#ifndef RID_SLOT_BITS
+#define RID_SLOT_BITS 10
+#endif
+#define RID_MAX_SLOTS (1u << RID_SLOT_BITS)
+#define RID_MAX_BLOCKS (1u << (32 - RID_SLOT_BITS))
+
+inline RID makeRID(int blockNum, int slot) {
+    return ((RID)blockNum << RID_SLOT_BITS) | (RID)slot;
+}
+
+inline int getRIDBlock(RID rid) {
+    return (int)(rid >> RID_SLOT_BITS);
+}
+
+inline int getRIDSlot(RID rid) {
+    return (int)(rid & (RID_MAX_SLOTS - 1));
+}
+
+#endif
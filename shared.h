@@ -0,0 +1,34 @@
+#ifndef SHARED_H
+#define SHARED_H
+
+// Access to plain fields that optimistic readers load while the writer of a concurrent BPTree changes them.
+// The fields keep their layout for the code that owns them; each shared load and store is atomic, so a
+// racing reader sees an old or a new value, never a torn one, and finds out through the versions it checks.
+// Relaxed accesses are for values, pointers to nodes and lists set up beforehand go through release and
+// acquire so their contents are visible once the pointer is.
+
+template <typename T>
+inline T loadRelaxed(const T &field) {
+    T value;
+    __atomic_load(&field, &value, __ATOMIC_RELAXED);
+    return value;
+}
+
+template <typename T>
+inline void storeRelaxed(T &field, T value) {
+    __atomic_store(&field, &value, __ATOMIC_RELAXED);
+}
+
+template <typename T>
+inline T loadAcquire(const T &field) {
+    T value;
+    __atomic_load(&field, &value, __ATOMIC_ACQUIRE);
+    return value;
+}
+
+template <typename T>
+inline void storeRelease(T &field, T value) {
+    __atomic_store(&field, &value, __ATOMIC_RELEASE);
+}
+
+#endif
@@ -1,42 +1,486 @@
 #include "storage.h"
 
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #include <tuple>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#ifdef __linux__
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "mappedfile.h"
 
 typedef unsigned char uchar;
 
 using namespace std;
 
+#define STORAGE_FILE_MAGIC 0x32544f53 //"STO2", 64-bit sizes
+
+//Slotted blocks: | SlottedHeader | slot directory | free space | records, last slot first |
+#define SLOT_ENTRY_SIZE 2 //directory entry, offset of the record in the block
+#define SLOT_TOMBSTONE 0x8000 //set in the entry of a deleted record, its offset is kept for reuse
+
+//PAX blocks: | averageRating of every slot | numVotes of every slot | tconst of every slot | unused |
+
+//Compressed blocks: | CompressedHeader | rating dictionary | packed rating codes | packed numVotes | packed tconst deltas |
+//numVotes are kept as their difference to the smallest one in the block (frame of reference), a tconst as its
+//difference to the one in the previous slot minus the smallest such difference, both in as few bits as the largest needs
+
+#define COMPACT_TCONST_DIGITS 7 //digits a tconst of char[10] has room for, below 1 << 24
+
+//Header at the start of a block file
+struct StorageHeader {
+    int magic;
+    int blockCapacity;
+    long long storageCapacity;
+    long long storageSizeAllocated;
+    long long storageSizeUsed;
+    int numRecords;
+    int blockSizeUsed;
+    int blocksUsed;
+    int blockFormat;
+    int recordEncoding; //0, FULL_RECORDS, in files from before compact records
+};
+
+//Header at the start of a slotted block
+struct SlottedHeader {
+    uint16_t numSlots; //slots in the directory, deleted ones included
+    uint16_t numHoles; //deleted slots
+};
+
+static SlottedHeader *getSlottedHeader(uchar *block){
+    return (SlottedHeader *) block;
+}
+
+static uint16_t *getSlotDirectory(uchar *block){
+    return (uint16_t *)(block + sizeof(SlottedHeader));
+}
+
+//Header at the start of a block of COMPRESSED_BLOCKS storage
+struct CompressedHeader {
+    uint16_t numRecords;
+    uint16_t numRatings;     //entries in the rating dictionary
+    uint8_t compressed;      //0 while records are appended whole after the header
+    uint8_t ratingBits;      //bits of a dictionary code
+    uint8_t votesBits;       //bits of numVotes - votesBase
+    uint8_t tconstBits;      //bits of a tconst delta - tconstDeltaBase
+    int votesBase;           //smallest numVotes
+    uint32_t tconstFirst;    //tconst of slot 0 in compact form
+    int tconstDeltaBase;     //smallest difference between the tconsts of consecutive slots
+};
+
+static CompressedHeader *getCompressedHeader(const uchar *block){
+    return (CompressedHeader *) block;
+}
+
+//Where the parts of a compressed block start, and the bytes it takes
+struct CompressedLayout {
+    int codesOffset;
+    int votesOffset;
+    int tconstOffset;
+    int size;
+};
+
+static int getPackedBytes(long long numValues, int bits){
+    return (numValues * bits + 7) / 8;
+}
+
+static CompressedLayout getCompressedLayout(int numRecords, int numRatings, int ratingBits, int votesBits, int tconstBits){
+    CompressedLayout layout;
+    layout.codesOffset = sizeof(CompressedHeader) + numRatings * sizeof(float);
+    layout.votesOffset = layout.codesOffset + getPackedBytes(numRecords, ratingBits);
+    layout.tconstOffset = layout.votesOffset + getPackedBytes(numRecords, votesBits);
+    layout.size = layout.tconstOffset + getPackedBytes(max(numRecords - 1, 0), tconstBits);
+    return layout;
+}
+
+static CompressedLayout getCompressedLayout(const CompressedHeader *header){
+    return getCompressedLayout(header->numRecords, header->numRatings, header->ratingBits, header->votesBits, header->tconstBits);
+}
+
+//Bits needed for values up to maxValue
+static int getBitWidth(uint32_t maxValue){
+    int bits = 0;
+    while (bits < 32 && (maxValue >> bits) != 0){
+        bits++;
+    }
+    return bits;
+}
+
+//Write values of bits each from the start of out, lowest bit first, values are below 1 << bits
+static void packBits(const uint32_t *values, int numValues, int bits, uchar *out){
+    uint64_t buffer = 0;
+    int numBuffered = 0; //bits in buffer, below 8 between values
+    for (int i = 0; i < numValues; i++){
+        buffer |= (uint64_t) values[i] << numBuffered;
+        numBuffered += bits;
+        while (numBuffered >= 8){
+            *out++ = (uchar) buffer;
+            buffer >>= 8;
+            numBuffered -= 8;
+        }
+    }
+    if (numBuffered > 0){
+        *out = (uchar) buffer;
+    }
+}
+
+//Read numValues values of bits each from value first on, bytes from end on are never read
+//A value is shifted out of one unaligned 8-byte load, only the last few before end are copied byte by byte
+static void unpackBits(const uchar *in, int first, int numValues, int bits, uint32_t *values, const uchar *end){
+    if (bits == 0){
+        memset(values, 0, numValues * sizeof(uint32_t));
+        return;
+    }
+    uint64_t mask = (bits == 32) ? 0xffffffffull : ((1ull << bits) - 1);
+    long long bitPos = (long long) first * bits;
+    //values whose 8 bytes all lie before end
+    long long lastLoad = (end - in - (long long) sizeof(uint64_t)) * 8;
+    int numLoads = (lastLoad < bitPos) ? 0 : min((long long) numValues, (lastLoad - bitPos) / bits + 1);
+    int i = 0;
+    for (; i < numLoads; i++, bitPos += bits){
+        uint64_t word;
+        memcpy(&word, in + (bitPos >> 3), sizeof(uint64_t));
+        values[i] = (uint32_t)((word >> (bitPos & 7)) & mask);
+    }
+    for (; i < numValues; i++, bitPos += bits){
+        uint64_t word = 0;
+        memcpy(&word, in + (bitPos >> 3), end - (in + (bitPos >> 3)));
+        values[i] = (uint32_t)((word >> (bitPos & 7)) & mask);
+    }
+}
+
+//Compact form of a tconst, the number after "tt" with its num of digits in the high byte
+static uint32_t encodeTconst(const char *tconst, int size){
+    if (tconst[0] != 't' || tconst[1] != 't'){
+        throw logic_error("tconst is not tt followed by digits");
+    }
+    uint32_t number = 0;
+    int numDigits = 0;
+    for (int i = 2; i < size && tconst[i] != '\0'; i++){
+        if (tconst[i] < '0' || tconst[i] > '9' || numDigits == COMPACT_TCONST_DIGITS){
+            throw logic_error("tconst is not tt followed by digits");
+        }
+        number = number * 10 + (tconst[i] - '0');
+        numDigits++;
+    }
+    return ((uint32_t) numDigits << 24) | number;
+}
+
+//tconst of its compact form, with its leading zeros
+static void decodeTconst(uint32_t compact, char *tconst){
+    int numDigits = compact >> 24;
+    uint32_t number = compact & ((1u << 24) - 1);
+    tconst[0] = 't';
+    tconst[1] = 't';
+    for (int i = numDigits + 1; i >= 2; i--){
+        tconst[i] = '0' + number % 10;
+        number /= 10;
+    }
+    tconst[numDigits + 2] = '\0';
+}
+
+//Minipages of a PAX block, the fields scans read ahead of tconst, no padding between records
+static PaxLayout makePaxLayout(int blockCapacity, RecordEncoding encoding){
+    PaxLayout layout;
+    layout.ratingSize = (encoding == COMPACT_RECORDS) ? sizeof(uint16_t) : sizeof(float);
+    layout.tconstSize = (encoding == COMPACT_RECORDS) ? sizeof(uint32_t) : sizeof(((Record *) 0)->tconst);
+    layout.numRecords = min(blockCapacity / (layout.ratingSize + sizeof(int) + layout.tconstSize), (size_t) RID_MAX_SLOTS);
+    layout.ratingsOffset = 0;
+    layout.votesOffset = layout.numRecords * layout.ratingSize;
+    layout.tconstOffset = layout.votesOffset + layout.numRecords * sizeof(int);
+    return layout;
+}
+
+//Zone map of a block without records, no predicate matches it
+static const ZoneMap EMPTY_ZONE_MAP = {INT_MAX, INT_MIN, INFINITY, -INFINITY, 0};
+
+//Allocate an in-memory extent, on huge pages where the OS has them
+static uchar *allocateExtent(long long size){
+#if STORAGE_HUGE_PAGES && defined(__linux__)
+    size = (size + STORAGE_HUGE_PAGE_SIZE - 1) / STORAGE_HUGE_PAGE_SIZE * STORAGE_HUGE_PAGE_SIZE;
+    void *extent = nullptr;
+    if (posix_memalign(&extent, STORAGE_HUGE_PAGE_SIZE, size) != 0){
+        return nullptr;
+    }
+    madvise(extent, size, MADV_HUGEPAGE); //only a hint, pages stay small if huge pages are off
+    return (uchar *) extent;
+#else
+    return new (nothrow) uchar[size];
+#endif
+}
+
+static void freeExtent(uchar *extent){
+#if STORAGE_HUGE_PAGES && defined(__linux__)
+    free(extent);
+#else
+    delete[] extent;
+#endif
+}
+
 //Storage Constructor
-Storage::Storage(int storageCapacity, int blockCapacity){
+Storage::Storage(long long storageCapacity, int blockCapacity, BlockFormat format, RecordEncoding encoding){
+    __storageCapacity = storageCapacity;
+    __blockCapacity = blockCapacity;
+    __format = format;
+    __encoding = encoding;
+    __pax = makePaxLayout(blockCapacity, encoding);
+
+    __storageSizeAllocated = 0;
+    __storageSizeUsed = 0;
+    __blockPtr = nullptr;
+    __blockSizeUsed = 0;
+    __blocksUsed = 0;
+    __numRecords = 0;
+    __file = nullptr;
+    initExtents();
+}
+
+//Storage Constructor for a block file
+Storage::Storage(string filename, long long storageCapacity, int blockCapacity, BlockFormat format, RecordEncoding encoding){
     __storageCapacity = storageCapacity;
     __blockCapacity = blockCapacity;
+    __format = format;
+    __encoding = encoding;
+    __pax = makePaxLayout(blockCapacity, encoding);
 
-    __storagePtr = new uchar[storageCapacity];
     __storageSizeAllocated = 0;
     __storageSizeUsed = 0;
     __blockPtr = nullptr;
     __blockSizeUsed = 0;
-    __blocksAvail = storageCapacity / blockCapacity;
     __blocksUsed = 0;
     __numRecords = 0;
+    __filename = filename;
+
+    __file = new MappedFile();
+    if (!__file->open(filename, STORAGE_HEADER_SIZE, true)){
+        cout << "Unable to map block file " << filename << ", using in-memory storage" << endl;
+        delete __file;
+        __file = nullptr;
+        initExtents();
+        return;
+    }
+
+    StorageHeader *header = (StorageHeader *) __file->getData();
+    if (header->magic == STORAGE_FILE_MAGIC){ //existing block file, restore counters
+        if (header->blockCapacity != blockCapacity || header->blockFormat != format || header->recordEncoding != encoding){
+            cout << "Block file " << filename << " uses " << header->blockCapacity << "B blocks of another format or record encoding, using in-memory storage" << endl;
+            delete __file;
+            __file = nullptr;
+            initExtents();
+            return;
+        }
+        __storageCapacity = header->storageCapacity;
+        __storageSizeAllocated = header->storageSizeAllocated;
+        __storageSizeUsed = header->storageSizeUsed;
+        __numRecords = header->numRecords;
+        __blockSizeUsed = header->blockSizeUsed;
+        __blocksUsed = header->blocksUsed;
+    }
+    initExtents();
+    while (((long long) __extents.size() << __extentShift) < __blocksUsed){ //map extents holding the stored blocks
+        if (!addExtent()){
+            cout << "Unable to map blocks of " << filename << ", using in-memory storage" << endl;
+            releaseExtents();
+            delete __file;
+            __file = nullptr;
+            __storageSizeAllocated = 0;
+            __storageSizeUsed = 0;
+            __blockSizeUsed = 0;
+            __blocksUsed = 0;
+            __numRecords = 0;
+            initExtents();
+            return;
+        }
+    }
+    __blocksAvail -= __blocksUsed;
+    if (__blocksUsed > 0){
+        __blockPtr = getBlockAddress(__blocksUsed - 1); //continue in last block
+    }
+    findHoles();
+    resetZoneMaps();
+    writeHeader();
 }
 
 //Storage Destructor
 Storage::~Storage(){
-    delete __storagePtr;
-    __storagePtr = nullptr;
+    if (__file != nullptr){
+        flush();
+        delete __file;
+        __file = nullptr;
+    }
+    releaseExtents();
+}
+
+//Size extents so that a block never crosses one, extents are a power of two blocks
+void Storage::initExtents(){
+    long long maxCapacity = (long long) RID_MAX_BLOCKS * __blockCapacity; //block num has to fit in a RID
+    if (__storageCapacity <= 0 || __storageCapacity > maxCapacity){
+        __storageCapacity = maxCapacity;
+    }
+    __blocksAvail = __storageCapacity / __blockCapacity;
+
+    __extentShift = 0;
+    while (((long long) __blockCapacity << (__extentShift + 1)) <= STORAGE_EXTENT_SIZE){
+        __extentShift++;
+    }
+    __blocksPerExtent = 1 << __extentShift;
+    __extents.reserve((__blocksAvail + __blocksPerExtent - 1) / __blocksPerExtent);
+}
+
+//Allocate the next extent, or map it from the block file
+//The last extent only holds the blocks left below the capacity
+bool Storage::addExtent(){
+    long long firstBlock = (long long) __extents.size() << __extentShift;
+    long long numBlocks = min((long long) __blocksPerExtent, __storageCapacity / __blockCapacity - firstBlock);
+    if (numBlocks <= 0){
+        return false;
+    }
+
+    uchar *extent;
+    if (__file != nullptr){ //extents follow each other in the file, blocks are where they always were
+        MappedFile *extentFile = new MappedFile();
+        if (!extentFile->open(__filename, numBlocks * __blockCapacity, true, STORAGE_HEADER_SIZE + firstBlock * __blockCapacity)){
+            delete extentFile;
+            return false;
+        }
+        __extentFiles.push_back(extentFile);
+        extent = extentFile->getData();
+    }
+    else{
+        extent = allocateExtent(numBlocks * __blockCapacity);
+        if (extent == nullptr){
+            return false;
+        }
+    }
+    __extents.push_back(extent);
+    return true;
+}
+
+//Free in-memory extents, or unmap the extents of the block file
+void Storage::releaseExtents(){
+    if (__extentFiles.empty()){
+        for (size_t i = 0; i < __extents.size(); i++){
+            freeExtent(__extents[i]);
+        }
+    }
+    for (size_t i = 0; i < __extentFiles.size(); i++){
+        delete __extentFiles[i];
+    }
+    __extentFiles.clear();
+    __extents.clear();
+}
+
+//Punch the pages out of the block file, or drop them from memory
+//Pages shared with a block outside the range are kept
+void Storage::releasePages(int firstBlock, int lastBlock){
+#ifdef __linux__
+    long long pageSize = sysconf(_SC_PAGESIZE);
+    while (firstBlock < lastBlock){ //blocks never cross an extent, release extent by extent
+        int extentEnd = min(lastBlock, ((firstBlock >> __extentShift) + 1) << __extentShift);
+        uintptr_t start = (uintptr_t) getBlockAddress(firstBlock);
+        uintptr_t end = start + (uintptr_t) (extentEnd - firstBlock) * __blockCapacity;
+        start = (start + pageSize - 1) / pageSize * pageSize;
+        end = end / pageSize * pageSize;
+        if (start < end){ //only a hint, pages stay if the file system cannot punch holes
+            madvise((void *) start, end - start, (__file != nullptr) ? MADV_REMOVE : MADV_DONTNEED);
+        }
+        firstBlock = extentEnd;
+    }
+#endif
+}
+
+//Copy counters into the block file header
+void Storage::writeHeader(){
+    StorageHeader *header = (StorageHeader *) __file->getData();
+    header->magic = STORAGE_FILE_MAGIC;
+    header->blockCapacity = __blockCapacity;
+    header->storageCapacity = __storageCapacity;
+    header->storageSizeAllocated = __storageSizeAllocated;
+    header->storageSizeUsed = __storageSizeUsed;
+    header->numRecords = __numRecords;
+    header->blockSizeUsed = __blockSizeUsed;
+    header->blocksUsed = __blocksUsed;
+    header->blockFormat = __format;
+    header->recordEncoding = __encoding;
+}
+
+//Write blocks and counters back to the block file
+void Storage::flush(){
+    if (__file != nullptr){
+        writeHeader();
+        __file->sync();
+        for (size_t i = 0; i < __extentFiles.size(); i++){
+            __extentFiles[i]->sync();
+        }
+    }
+}
+
+//Check if Storage is backed by a block file
+bool Storage::isPersistent(){
+    return __file != nullptr;
+}
+
+BlockFormat Storage::getBlockFormat(){
+    return __format;
+}
+
+RecordEncoding Storage::getRecordEncoding(){
+    return __encoding;
+}
+
+//Encode a Record into its compact form
+CompactRecord Storage::encodeRecord(const Record &record){
+    CompactRecord compact;
+    compact.tconst = encodeTconst(record.tconst, sizeof(record.tconst));
+
+    float averageRating = roundf(record.averageRating * COMPACT_RATING_SCALE);
+    if (!(averageRating >= 0 && averageRating <= UINT16_MAX)){ //NaN too
+        throw logic_error("averageRating exceeded compact record range");
+    }
+    compact.averageRating = (uint16_t) averageRating;
+    compact.numVotes = record.numVotes;
+    return compact;
+}
+
+//Decode a compact Record, tconst gets back its leading zeros
+Record Storage::decodeRecord(const CompactRecord &compact){
+    Record record;
+    decodeTconst(compact.tconst, record.tconst);
+    record.averageRating = decodeCompactRating(compact.averageRating);
+    record.numVotes = compact.numVotes;
+    return record;
+}
+
+//Get address of a Block by its number
+uchar *Storage::getBlockAddress(int blockNum){
+    return __extents[blockNum >> __extentShift] + (blockNum & (__blocksPerExtent - 1)) * __blockCapacity;
 }
 
 //Get max size of Storage
-int Storage::getStorageCapacity(){
+long long Storage::getStorageCapacity(){
     return __storageCapacity;
 }
 
+//Get size of the blocks allocated within Storage
+long long Storage::getStorageSizeAllocated(){
+    return __storageSizeAllocated;
+}
+
 //Get space utilized by records within Storage
-int Storage::getStorageSizeUsed(){
+long long Storage::getStorageSizeUsed(){
     return __storageSizeUsed;
 }
 
@@ -63,11 +507,28 @@ int Storage::getBlocksUsed(){
 //Create a new Block in the Storage
 bool Storage::Storage::createBlock(){
     if (__blocksAvail > 0){
-        __blockPtr = (uchar*) __storagePtr + (__blocksUsed * __blockCapacity); //point to new block.
+        if ((__blocksUsed >> __extentShift) >= (int) __extents.size() && !addExtent()){ //first block of an extent
+            return false;
+        }
+        __blockPtr = getBlockAddress(__blocksUsed); //point to new block.
         __blocksUsed++; // +1 num of blocks used
         __blocksAvail--; // -1 num of blocks available
         __storageSizeAllocated += __blockCapacity; //empty block but storage size allocated.
         __blockSizeUsed = 0; //new block, 0 / blockCapacity used.
+        if (__format == SLOTTED_BLOCKS){ //empty slot directory
+            SlottedHeader *header = getSlottedHeader(__blockPtr);
+            header->numSlots = 0;
+            header->numHoles = 0;
+            __blockSizeUsed = sizeof(SlottedHeader);
+            __listed.push_back(false);
+            __draining.push_back(false);
+        }
+        if (__format == COMPRESSED_BLOCKS){ //records are appended whole until the block is compressed
+            memset(__blockPtr, 0, sizeof(CompressedHeader));
+            __blockSizeUsed = sizeof(CompressedHeader);
+        }
+        __zoneMaps.push_back(EMPTY_ZONE_MAP);
+        __zoneStale.push_back(false);
         return true;
     }
     else{
@@ -75,25 +536,725 @@ bool Storage::Storage::createBlock(){
     }
 }
 
-//Returns address of the added record
-tuple <uchar *, int> Storage::addRecord(int recordSize){
+//Bytes a record takes in a block
+int Storage::getRecordBytes(int recordSize){
+    if (__format == PAX_BLOCKS){
+        return __pax.ratingSize + sizeof(int) + __pax.tconstSize;
+    }
+    recordSize = getStoredSize(recordSize);
+    return (__format == SLOTTED_BLOCKS) ? recordSize + SLOT_ENTRY_SIZE : recordSize;
+}
+
+//Bytes in front of the records of a Block
+int Storage::getBlockHeaderSize(){
+    if (__format == SLOTTED_BLOCKS){
+        return sizeof(SlottedHeader);
+    }
+    return (__format == COMPRESSED_BLOCKS) ? sizeof(CompressedHeader) : 0;
+}
+
+//Records of recordSize fitting in a Block, capped at the slots a RID addresses
+int Storage::getRecordsPerBlock(int recordSize){
+    return min((__blockCapacity - getBlockHeaderSize()) / getRecordBytes(recordSize), (int) RID_MAX_SLOTS);
+}
+
+//Bytes a record is stored in, compact records are only encoded from Records
+int Storage::getStoredSize(int recordSize){
+    if (__encoding != COMPACT_RECORDS){
+        return recordSize;
+    }
+    if (recordSize != (int) sizeof(Record)){
+        throw logic_error("Compact records only hold Records");
+    }
+    return sizeof(CompactRecord);
+}
+
+//Returns RID of the added record
+RID Storage::addRecord(int recordSize){
+    lock_guard<mutex> guard(__lock);
+    RID rid;
+    if (reuseHole(rid)){
+        __storageSizeUsed += getStoredSize(recordSize);
+        __numRecords++;
+        return rid;
+    }
+    return appendRecord(recordSize);
+}
+
+//Take a deleted slot from the last block that had a record deleted, caller holds the lock
+bool Storage::reuseHole(RID &rid){
+    while (!__holeBlocks.empty()){
+        int blockNum = __holeBlocks.back();
+        uchar *block = getBlockAddress(blockNum);
+        SlottedHeader *header = getSlottedHeader(block);
+        if (header->numHoles == 0 || __draining[blockNum]){ //holes already reused, or listed again once drained
+            __holeBlocks.pop_back();
+            __listed[blockNum] = false;
+            continue;
+        }
+        uint16_t *slots = getSlotDirectory(block);
+        for (int slot = 0; slot < header->numSlots; slot++){
+            if (slots[slot] & SLOT_TOMBSTONE){
+                slots[slot] &= ~SLOT_TOMBSTONE; //record goes where the deleted one was
+                header->numHoles--;
+                if (header->numHoles == 0){
+                    __holeBlocks.pop_back();
+                    __listed[blockNum] = false;
+                }
+                rid = makeRID(blockNum, slot);
+                markStale(blockNum);
+                return true;
+            }
+        }
+        __holeBlocks.pop_back();
+        __listed[blockNum] = false;
+    }
+    return false;
+}
+
+//List a block in the free-space map, caller holds the lock
+void Storage::listHoles(int blockNum){
+    if (!__listed[blockNum] && !__draining[blockNum] && getSlottedHeader(getBlockAddress(blockNum))->numHoles > 0){
+        __holeBlocks.push_back(blockNum);
+        __listed[blockNum] = true;
+    }
+}
 
-    if(__blockCapacity - __blockSizeUsed < recordSize || __blocksUsed == 0){ //unable to fit in current block
+//Copy a record for a vacuum, the original stays live until it is deleted
+RID Storage::copyRecord(RID rid){
+    lock_guard<mutex> guard(__lock);
+    RID copy;
+    if (reuseHole(copy)){
+        __storageSizeUsed += getStoredSize(sizeof(Record));
+        __numRecords++;
+    }
+    else{
+        copy = appendRecord(sizeof(Record));
+    }
+    writeRecord(copy, readRecord(rid));
+    return copy;
+}
+
+//Mark a slotted block draining or not, a drained block goes back to the free-space map
+//The last block takes appended records and is never drained
+void Storage::setDraining(int blockNum, bool draining){
+    lock_guard<mutex> guard(__lock);
+    if (__format != SLOTTED_BLOCKS || blockNum >= __blocksUsed - 1){
+        return;
+    }
+    __draining[blockNum] = draining;
+    if (!draining){
+        listHoles(blockNum);
+    }
+}
+
+//Lower the block count past the empty blocks at the end, the next block appended takes their place
+int Storage::releaseEmptyBlocks(){
+    lock_guard<mutex> guard(__lock);
+    if (__format != SLOTTED_BLOCKS){
+        return 0;
+    }
+    int blocksUsed = __blocksUsed;
+    while (__blocksUsed > 0 && getNumLiveRecords(__blocksUsed - 1) == 0 && !__draining[__blocksUsed - 1]){
+        __blocksUsed--;
+    }
+    int numReleased = blocksUsed - __blocksUsed;
+    if (numReleased == 0){
+        return 0;
+    }
+    __blocksAvail += numReleased;
+    __storageSizeAllocated -= (long long) numReleased * __blockCapacity;
+    __listed.resize(__blocksUsed);
+    __draining.resize(__blocksUsed);
+    __zoneMaps.resize(__blocksUsed);
+    __zoneStale.resize(__blocksUsed);
+    int numBlocks = __blocksUsed;
+    __holeBlocks.erase(remove_if(__holeBlocks.begin(), __holeBlocks.end(), [numBlocks](int blockNum){ return blockNum >= numBlocks; }),
+                       __holeBlocks.end());
+    __staleBlocks.erase(remove_if(__staleBlocks.begin(), __staleBlocks.end(), [numBlocks](int blockNum){ return blockNum >= numBlocks; }),
+                        __staleBlocks.end());
+
+    //records are appended after the slots of the new last block
+    __blockPtr = nullptr;
+    __blockSizeUsed = 0;
+    if (__blocksUsed > 0){
+        __blockPtr = getBlockAddress(__blocksUsed - 1);
+        __blockSizeUsed = sizeof(SlottedHeader) + getSlottedHeader(__blockPtr)->numSlots * getRecordBytes(sizeof(Record));
+    }
+    releasePages(__blocksUsed, blocksUsed);
+    return numReleased;
+}
+
+//Get num of live records in a Block
+int Storage::getNumLiveRecords(int blockNum){
+    if (__format == COMPRESSED_BLOCKS){
+        return getCompressedHeader(getBlockAddress(blockNum))->numRecords;
+    }
+    if (__format == SLOTTED_BLOCKS){
+        SlottedHeader *header = getSlottedHeader(getBlockAddress(blockNum));
+        return header->numSlots - header->numHoles;
+    }
+    if (blockNum < __blocksUsed - 1){ //blocks before the last one are full
+        return getMaxRecordsPerBlock();
+    }
+    return __blockSizeUsed / getRecordBytes(sizeof(Record));
+}
+
+//Get max num of Records within a Block
+int Storage::getMaxRecordsPerBlock(){
+    return getRecordsPerBlock(sizeof(Record));
+}
+
+//Get max num of slots a block may use
+int Storage::getMaxSlotsPerBlock(){
+    if (__format == COMPRESSED_BLOCKS){ //as many as a RID has slots for, fields that never change take 0 bits
+        return RID_MAX_SLOTS;
+    }
+    return getMaxRecordsPerBlock();
+}
+
+//Mark a record of a slotted block deleted, its slot is reused by a later addRecord
+bool Storage::deleteRecord(RID rid){
+    if (__format != SLOTTED_BLOCKS){
+        throw logic_error("Records can only be deleted from slotted blocks");
+    }
+    lock_guard<mutex> guard(__lock);
+    int blockNum = getRIDBlock(rid);
+    int slot = getRIDSlot(rid);
+    if (blockNum >= __blocksUsed){
+        return false;
+    }
+    uchar *block = getBlockAddress(blockNum);
+    SlottedHeader *header = getSlottedHeader(block);
+    uint16_t *slots = getSlotDirectory(block);
+    if (slot >= header->numSlots || (slots[slot] & SLOT_TOMBSTONE)){
+        return false;
+    }
+    slots[slot] |= SLOT_TOMBSTONE;
+    header->numHoles++;
+    listHoles(blockNum);
+    markStale(blockNum);
+    __storageSizeUsed -= getStoredSize(sizeof(Record));
+    __numRecords--;
+    return true;
+}
+
+//Get slots and offsets of the live records in a Block
+int Storage::getLiveRecords(int blockNum, const uchar *block, int *slots, int *offsets){
+    if (__format == SLOTTED_BLOCKS){
+        SlottedHeader *header = getSlottedHeader((uchar *) block);
+        uint16_t *directory = getSlotDirectory((uchar *) block);
+        int numRecords = 0;
+        for (int slot = 0; slot < header->numSlots; slot++){
+            if (!(directory[slot] & SLOT_TOMBSTONE)){
+                slots[numRecords] = slot;
+                offsets[numRecords] = directory[slot];
+                numRecords++;
+            }
+        }
+        return numRecords;
+    }
+    int numRecords = getNumLiveRecords(blockNum);
+    bool bySlot = __format == PAX_BLOCKS; //records have no offset of their own
+    if (__format == COMPRESSED_BLOCKS){
+        numRecords = getCompressedHeader(block)->numRecords;
+        bySlot = isCompressed(block);
+    }
+    for (int slot = 0; slot < numRecords; slot++){
+        slots[slot] = slot;
+        offsets[slot] = bySlot ? slot : getBlockHeaderSize() + slot * getStoredSize(sizeof(Record));
+    }
+    return numRecords;
+}
+
+//Queue a block for refreshZoneMaps, caller holds the lock
+void Storage::markStale(int blockNum){
+    if (!__zoneStale[blockNum]){
+        __zoneStale[blockNum] = true;
+        __staleBlocks.push_back(blockNum);
+    }
+}
+
+//Every block used gets a zone map computed on the next refresh
+void Storage::resetZoneMaps(){
+    __zoneMaps.assign(__blocksUsed, EMPTY_ZONE_MAP);
+    __zoneStale.assign(__blocksUsed, false);
+    __staleBlocks.clear();
+    for (int blockNum = 0; blockNum < __blocksUsed; blockNum++){
+        markStale(blockNum);
+    }
+}
+
+//Recompute zone maps of the blocks whose records changed
+void Storage::refreshZoneMaps(){
+    lock_guard<mutex> guard(__lock);
+    vector<RID> rids;
+    for (size_t i = 0; i < __staleBlocks.size(); i++){
+        int blockNum = __staleBlocks[i];
+        ZoneMap zoneMap = EMPTY_ZONE_MAP;
+        rids.clear();
+        getRIDs(blockNum, rids);
+        for (size_t j = 0; j < rids.size(); j++){
+            int numVotes = getNumVotes(rids[j]);
+            float averageRating = getAverageRating(rids[j]);
+            zoneMap.minVotes = min(zoneMap.minVotes, numVotes);
+            zoneMap.maxVotes = max(zoneMap.maxVotes, numVotes);
+            zoneMap.minRating = min(zoneMap.minRating, averageRating);
+            zoneMap.maxRating = max(zoneMap.maxRating, averageRating);
+        }
+        zoneMap.numRecords = rids.size();
+        __zoneMaps[blockNum] = zoneMap;
+        __zoneStale[blockNum] = false;
+    }
+    __staleBlocks.clear();
+}
+
+//Get zone map of a Block
+const ZoneMap &Storage::getZoneMap(int blockNum){
+    return __zoneMaps[blockNum];
+}
+
+//Rebuild the free-space map of slotted blocks
+void Storage::findHoles(){
+    __holeBlocks.clear();
+    if (__format != SLOTTED_BLOCKS){
+        return;
+    }
+    __listed.assign(__blocksUsed, false);
+    __draining.assign(__blocksUsed, false);
+    for (int blockNum = 0; blockNum < __blocksUsed; blockNum++){
+        listHoles(blockNum);
+    }
+}
+
+//Reserve space for numRecords consecutive records, returns RID of the first
+//Records fill blocks in the same way as addRecord, callers step through them with getNextRID
+RID Storage::reserveRecords(int numRecords, int recordSize){
+    lock_guard<mutex> guard(__lock);
+    if (numRecords <= 0){
+        return makeRID(__blocksUsed, 0);
+    }
+
+    RID first = appendRecord(recordSize);
+    for (int i = 1; i < numRecords; i++){
+        appendRecord(recordSize);
+    }
+    return first;
+}
+
+//Rewrite records from the first block on in the order of rids, holes and dropped records go away
+void Storage::rewriteRecords(vector<RID> &rids){
+    lock_guard<mutex> guard(__lock);
+    vector<Record> records(rids.size());
+    for (size_t i = 0; i < rids.size(); i++){
+        records[i] = readRecord(rids[i]);
+    }
+    vector<uint32_t> tconsts;
+    if (__format == COMPRESSED_BLOCKS){ //every tconst is checked before the blocks are overwritten
+        if (!records.empty() && getCompressedLayout(1, 1, 0, 0, 0).size > __blockCapacity){
+            throw logic_error("RecordSize exceeded Block Capacity");
+        }
+        tconsts.resize(records.size());
+        for (size_t i = 0; i < records.size(); i++){
+            tconsts[i] = encodeTconst(records[i].tconst, sizeof(records[i].tconst));
+        }
+    }
+
+    //blocks are refilled from the first one, extents stay allocated
+    __blocksAvail += __blocksUsed;
+    __blocksUsed = 0;
+    __blockPtr = nullptr;
+    __blockSizeUsed = 0;
+    __storageSizeAllocated = 0;
+    __storageSizeUsed = 0;
+    __numRecords = 0;
+    __holeBlocks.clear();
+    __listed.clear();
+    __draining.clear();
+    __zoneMaps.clear();
+    __zoneStale.clear();
+    __staleBlocks.clear();
+
+    if (__format == COMPRESSED_BLOCKS){
+        writeCompressedBlocks(records, tconsts, rids);
+        return;
+    }
+    for (size_t i = 0; i < rids.size(); i++){
+        rids[i] = appendRecord(sizeof(Record));
+        writeRecord(rids[i], records[i]);
+    }
+}
+
+//Fill each block with as many of the next records as it holds compressed
+void Storage::writeCompressedBlocks(const vector<Record> &records, const vector<uint32_t> &tconsts, vector<RID> &rids){
+    vector<float> dictionary;
+    vector<uint32_t> codes, votes, deltas;
+    size_t first = 0;
+    while (first < records.size()){
+        //grow the block record by record while the fields still fit in their bit widths
+        int votesBase = records[first].numVotes;
+        int maxVotes = votesBase;
+        long long minDelta = 0, maxDelta = 0;
+        dictionary.assign(1, records[first].averageRating);
+        codes.assign(1, 0);
+        size_t last = first + 1;
+        while (last < records.size() && last - first < RID_MAX_SLOTS){
+            const Record &record = records[last];
+            uint32_t code = 0;
+            while (code < dictionary.size() && memcmp(&dictionary[code], &record.averageRating, sizeof(float)) != 0){
+                code++;
+            }
+            int newMin = min(votesBase, record.numVotes);
+            int newMax = max(maxVotes, record.numVotes);
+            long long delta = (long long) tconsts[last] - tconsts[last - 1];
+            long long newMinDelta = (last == first + 1) ? delta : min(minDelta, delta);
+            long long newMaxDelta = (last == first + 1) ? delta : max(maxDelta, delta);
+            int numRatings = dictionary.size() + (code == dictionary.size());
+            CompressedLayout layout = getCompressedLayout(last - first + 1, numRatings, getBitWidth(numRatings - 1),
+                                                          getBitWidth((uint32_t) newMax - (uint32_t) newMin),
+                                                          getBitWidth(newMaxDelta - newMinDelta));
+            if (layout.size > __blockCapacity){
+                break;
+            }
+            if (code == dictionary.size()){
+                dictionary.push_back(record.averageRating);
+            }
+            codes.push_back(code);
+            votesBase = newMin;
+            maxVotes = newMax;
+            minDelta = newMinDelta;
+            maxDelta = newMaxDelta;
+            last++;
+        }
+
+        if (!createBlock()){
+            throw logic_error("Insufficient space in Storage for record");
+        }
+        int numRecords = last - first;
+        CompressedHeader *header = getCompressedHeader(__blockPtr);
+        header->numRecords = numRecords;
+        header->numRatings = dictionary.size();
+        header->compressed = 1;
+        header->ratingBits = getBitWidth(dictionary.size() - 1);
+        header->votesBits = getBitWidth((uint32_t) maxVotes - (uint32_t) votesBase);
+        header->tconstBits = getBitWidth(maxDelta - minDelta);
+        header->votesBase = votesBase;
+        header->tconstFirst = tconsts[first];
+        header->tconstDeltaBase = minDelta;
+
+        votes.resize(numRecords);
+        deltas.resize(max(numRecords - 1, 0));
+        for (int i = 0; i < numRecords; i++){
+            votes[i] = (uint32_t) records[first + i].numVotes - (uint32_t) votesBase;
+            if (i > 0){
+                deltas[i - 1] = (uint32_t)((long long) tconsts[first + i] - tconsts[first + i - 1] - minDelta);
+            }
+            rids[first + i] = makeRID(__blocksUsed - 1, i);
+        }
+        CompressedLayout layout = getCompressedLayout(header);
+        memcpy(__blockPtr + sizeof(CompressedHeader), dictionary.data(), dictionary.size() * sizeof(float));
+        packBits(codes.data(), numRecords, header->ratingBits, __blockPtr + layout.codesOffset);
+        packBits(votes.data(), numRecords, header->votesBits, __blockPtr + layout.votesOffset);
+        packBits(deltas.data(), numRecords - 1, header->tconstBits, __blockPtr + layout.tconstOffset);
+
+        markStale(__blocksUsed - 1);
+        __storageSizeUsed += layout.size;
+        __numRecords += numRecords;
+        first = last;
+    }
+    __blockSizeUsed = __blockCapacity; //records appended later start a block of their own
+}
+
+//RID of the reserved record after rid
+RID Storage::getNextRID(RID rid, int recordSize){
+    int blockNum = getRIDBlock(rid);
+    int slot = getRIDSlot(rid) + 1;
+    if (slot >= getRecordsPerBlock(recordSize)){ //unable to fit in current block
+        blockNum++;
+        slot = 0;
+    }
+    return makeRID(blockNum, slot);
+}
+
+//Get address of a Record by its RID
+Record *Storage::getRecord(RID rid){
+    if (__encoding == COMPACT_RECORDS){
+        throw logic_error("Compact records are read and written through readRecord and writeRecord");
+    }
+    uchar *block = getBlockAddress(getRIDBlock(rid));
+    return (Record *)(block + getRecordOffset(block, rid));
+}
+
+//Get offset of a Record in its block
+int Storage::getRecordOffset(const uchar *block, RID rid){
+    if (__format == SLOTTED_BLOCKS){
+        return getSlotDirectory((uchar *) block)[getRIDSlot(rid)] & ~SLOT_TOMBSTONE;
+    }
+    if (__format == PAX_BLOCKS){
+        throw logic_error("PAX blocks keep no record whole");
+    }
+    if (__format == COMPRESSED_BLOCKS && isCompressed(block)){
+        throw logic_error("Compressed blocks keep no record whole");
+    }
+    return getBlockHeaderSize() + getRIDSlot(rid) * getStoredSize(sizeof(Record));
+}
+
+//Get a copy of a Record by its RID
+Record Storage::readRecord(RID rid){
+    return readRecord(getBlockAddress(getRIDBlock(rid)), rid);
+}
+
+//Get a copy of a Record out of a block, gathering its fields from the minipages of PAX blocks
+Record Storage::readRecord(const uchar *block, RID rid){
+    Record record;
+    if (__format == COMPRESSED_BLOCKS && isCompressed(block)){
+        int slot = getRIDSlot(rid);
+        decodeTconst(getCompressedTconst(block, slot), record.tconst);
+        record.averageRating = getCompressedRating(block, slot);
+        record.numVotes = getCompressedVotes(block, slot);
+        return record;
+    }
+    if (__encoding == COMPACT_RECORDS){
+        CompactRecord compact;
+        if (__format == PAX_BLOCKS){
+            readPaxFields(block, getRIDSlot(rid), &compact.averageRating, &compact.numVotes, &compact.tconst);
+        }
+        else{
+            memcpy(&compact, block + getRecordOffset(block, rid), sizeof(CompactRecord));
+        }
+        return decodeRecord(compact);
+    }
+    if (__format == PAX_BLOCKS){
+        readPaxFields(block, getRIDSlot(rid), &record.averageRating, &record.numVotes, record.tconst);
+        return record;
+    }
+    memcpy(&record, block + getRecordOffset(block, rid), sizeof(Record));
+    return record;
+}
+
+//Overwrite a Record, scattering its fields over the minipages of PAX blocks
+void Storage::writeRecord(RID rid, const Record &record){
+    uchar *block = getBlockAddress(getRIDBlock(rid));
+    if (__format == COMPRESSED_BLOCKS && isCompressed(block)){
+        throw logic_error("Compressed blocks are read only");
+    }
+    if (__encoding == COMPACT_RECORDS){
+        CompactRecord compact = encodeRecord(record);
+        if (__format == PAX_BLOCKS){
+            writePaxFields(block, getRIDSlot(rid), &compact.averageRating, &compact.numVotes, &compact.tconst);
+        }
+        else{
+            memcpy(block + getRecordOffset(block, rid), &compact, sizeof(CompactRecord));
+        }
+        return;
+    }
+    if (__format == PAX_BLOCKS){
+        writePaxFields(block, getRIDSlot(rid), &record.averageRating, &record.numVotes, record.tconst);
+        return;
+    }
+    memcpy(block + getRecordOffset(block, rid), &record, sizeof(Record));
+}
+
+//Copy the fields of a slot out of the minipages of a PAX block
+void Storage::readPaxFields(const uchar *block, int slot, void *averageRating, void *numVotes, void *tconst){
+    memcpy(averageRating, block + __pax.ratingsOffset + slot * __pax.ratingSize, __pax.ratingSize);
+    memcpy(numVotes, block + __pax.votesOffset + slot * sizeof(int), sizeof(int));
+    memcpy(tconst, block + __pax.tconstOffset + slot * __pax.tconstSize, __pax.tconstSize);
+}
+
+//Copy the fields of a slot into the minipages of a PAX block
+void Storage::writePaxFields(uchar *block, int slot, const void *averageRating, const void *numVotes, const void *tconst){
+    memcpy(block + __pax.ratingsOffset + slot * __pax.ratingSize, averageRating, __pax.ratingSize);
+    memcpy(block + __pax.votesOffset + slot * sizeof(int), numVotes, sizeof(int));
+    memcpy(block + __pax.tconstOffset + slot * __pax.tconstSize, tconst, __pax.tconstSize);
+}
+
+//Get averageRating of a Record
+float Storage::getAverageRating(RID rid){
+    uchar *block = getBlockAddress(getRIDBlock(rid));
+    if (__format == COMPRESSED_BLOCKS && isCompressed(block)){
+        return getCompressedRating(block, getRIDSlot(rid));
+    }
+    const uchar *field = (__format == PAX_BLOCKS) ? block + __pax.ratingsOffset + getRIDSlot(rid) * __pax.ratingSize
+                       : (__encoding == COMPACT_RECORDS) ? block + getRecordOffset(block, rid) + offsetof(CompactRecord, averageRating)
+                       : block + getRecordOffset(block, rid) + offsetof(Record, averageRating);
+    if (__encoding == COMPACT_RECORDS){
+        uint16_t averageRating;
+        memcpy(&averageRating, field, sizeof(uint16_t));
+        return decodeCompactRating(averageRating);
+    }
+    float averageRating;
+    memcpy(&averageRating, field, sizeof(float));
+    return averageRating;
+}
+
+//Get numVotes of a Record
+int Storage::getNumVotes(RID rid){
+    uchar *block = getBlockAddress(getRIDBlock(rid));
+    if (__format == COMPRESSED_BLOCKS && isCompressed(block)){
+        return getCompressedVotes(block, getRIDSlot(rid));
+    }
+    const uchar *field = (__format == PAX_BLOCKS) ? block + __pax.votesOffset + getRIDSlot(rid) * sizeof(int)
+                       : (__encoding == COMPACT_RECORDS) ? block + getRecordOffset(block, rid) + offsetof(CompactRecord, numVotes)
+                       : block + getRecordOffset(block, rid) + offsetof(Record, numVotes);
+    int numVotes;
+    memcpy(&numVotes, field, sizeof(int));
+    return numVotes;
+}
+
+//Get minipage offsets of PAX blocks
+const PaxLayout &Storage::getPaxLayout(){
+    return __pax;
+}
+
+//Check if a Block has been compressed
+bool Storage::isCompressed(const uchar *block){
+    return getCompressedHeader(block)->compressed != 0;
+}
+
+//Get averageRating of a slot from the rating dictionary of a compressed block
+float Storage::getCompressedRating(const uchar *block, int slot){
+    const CompressedHeader *header = getCompressedHeader(block);
+    CompressedLayout layout = getCompressedLayout(header);
+    uint32_t code;
+    unpackBits(block + layout.codesOffset, slot, 1, header->ratingBits, &code, block + __blockCapacity);
+    float averageRating;
+    memcpy(&averageRating, block + sizeof(CompressedHeader) + code * sizeof(float), sizeof(float));
+    return averageRating;
+}
+
+//Get numVotes of a slot of a compressed block
+int Storage::getCompressedVotes(const uchar *block, int slot){
+    const CompressedHeader *header = getCompressedHeader(block);
+    CompressedLayout layout = getCompressedLayout(header);
+    uint32_t offset;
+    unpackBits(block + layout.votesOffset, slot, 1, header->votesBits, &offset, block + __blockCapacity);
+    return (int)((uint32_t) header->votesBase + offset);
+}
+
+//Get compact tconst of a slot of a compressed block, adding up the deltas of the slots before it
+uint32_t Storage::getCompressedTconst(const uchar *block, int slot){
+    const CompressedHeader *header = getCompressedHeader(block);
+    CompressedLayout layout = getCompressedLayout(header);
+    uint32_t deltas[RID_MAX_SLOTS];
+    unpackBits(block + layout.tconstOffset, 0, slot, header->tconstBits, deltas, block + __blockCapacity);
+    uint32_t tconst = header->tconstFirst;
+    for (int i = 0; i < slot; i++){
+        tconst += header->tconstDeltaBase + deltas[i];
+    }
+    return tconst;
+}
+
+//Get numVotes and averageRating of every record in a Block, decompressed column by column
+int Storage::decodeColumns(const uchar *block, int *votes, float *ratings){
+    const CompressedHeader *header = getCompressedHeader(block);
+    int numRecords = header->numRecords;
+    if (!header->compressed){
+        for (int slot = 0; slot < numRecords; slot++){
+            Record record = readRecord(block, makeRID(0, slot));
+            votes[slot] = record.numVotes;
+            ratings[slot] = record.averageRating;
+        }
+        return numRecords;
+    }
+
+    CompressedLayout layout = getCompressedLayout(header);
+    const uchar *end = block + __blockCapacity;
+    uint32_t *offsets = (uint32_t *) votes; //same size, numVotes are the offsets from votesBase
+    unpackBits(block + layout.votesOffset, 0, numRecords, header->votesBits, offsets, end);
+    for (int i = 0; i < numRecords; i++){
+        votes[i] = (int)((uint32_t) header->votesBase + offsets[i]);
+    }
+
+    float dictionary[RID_MAX_SLOTS];
+    uint32_t codes[RID_MAX_SLOTS];
+    memcpy(dictionary, block + sizeof(CompressedHeader), header->numRatings * sizeof(float));
+    unpackBits(block + layout.codesOffset, 0, numRecords, header->ratingBits, codes, end);
+    for (int i = 0; i < numRecords; i++){
+        ratings[i] = dictionary[codes[i]];
+    }
+    return numRecords;
+}
+
+//Get RIDs of live records, block by block
+void Storage::getRIDs(vector<RID> &rids){
+    for (int blockNum = 0; blockNum < __blocksUsed; blockNum++){
+        getRIDs(blockNum, rids);
+    }
+}
+
+//Get RIDs of the live records in a Block
+void Storage::getRIDs(int blockNum, vector<RID> &rids){
+    uchar *block = getBlockAddress(blockNum);
+    if (__format == SLOTTED_BLOCKS){
+        SlottedHeader *header = getSlottedHeader(block);
+        uint16_t *slots = getSlotDirectory(block);
+        for (int slot = 0; slot < header->numSlots; slot++){
+            if (!(slots[slot] & SLOT_TOMBSTONE)){
+                rids.push_back(makeRID(blockNum, slot));
+            }
+        }
+        return;
+    }
+    // records are packed from the start of every block, last block is partially used
+    int numRecords = getNumLiveRecords(blockNum);
+    for (int slot = 0; slot < numRecords; slot++){
+        rids.push_back(makeRID(blockNum, slot));
+    }
+}
+
+//Slot the next record appended to the current block takes, RID_MAX_SLOTS once the RIDs of the block run out
+int Storage::getNextSlot(int recordBytes){
+    if (__blocksUsed == 0){
+        return 0;
+    }
+    if (__format == SLOTTED_BLOCKS){ //record goes below the previous one
+        return getSlottedHeader(__blockPtr)->numSlots;
+    }
+    return (__blockSizeUsed - getBlockHeaderSize()) / recordBytes;
+}
+
+//Append a record to the current block, caller holds the lock
+//Nothing is written unless the record fits
+RID Storage::appendRecord(int recordSize){
+    int recordBytes = getRecordBytes(recordSize);
+
+    if( recordBytes > __blockCapacity - getBlockHeaderSize()){ //recordSize exceed block capacity
+        throw logic_error("RecordSize exceeded Block Capacity");
+    }
+
+    if (__format == SLOTTED_BLOCKS && __blockCapacity > SLOT_TOMBSTONE){ //offsets share the entry with the tombstone bit
+        throw logic_error("Block Capacity exceeded slotted block offsets");
+    }
+
+    if (__format == PAX_BLOCKS && recordSize != (int) sizeof(Record)){ //minipages are laid out for the fields of Record
+        throw logic_error("PAX blocks only hold Records");
+    }
+    recordSize = getStoredSize(recordSize); //compact records take their encoded size
+
+    int slot = getNextSlot(recordBytes);
+    if(__blockCapacity - __blockSizeUsed < recordBytes || slot >= (int) RID_MAX_SLOTS || __blocksUsed == 0){ //unable to fit in current block
         if(!createBlock()){ //unable to create new block
-            cout << "Insufficient space in Storage for record" << endl;
+            throw logic_error("Insufficient space in Storage for record");
         }
+        slot = 0;
     }
 
-    if( recordSize > __blockCapacity){ //recordSize exceed block capacity
-        cout << "RecordSize exceeded Block Capacity" << endl;
+    if (__format == SLOTTED_BLOCKS){ //its offset into the directory
+        getSlottedHeader(__blockPtr)->numSlots++;
+        getSlotDirectory(__blockPtr)[slot] = __blockCapacity - (slot + 1) * recordSize;
+    }
+    if (__format == COMPRESSED_BLOCKS){
+        getCompressedHeader(__blockPtr)->numRecords++;
     }
 
     //record can be written
-    //new record address = blockPtr + offset, <current block address , offset>    
-    tuple <uchar* , int> recordAddInfo((uchar*)__blockPtr, __blockSizeUsed);
+    //new record RID = <current block num, slot>
+    RID rid = makeRID(__blocksUsed - 1, slot);
+    markStale(__blocksUsed - 1);
     __storageSizeUsed += recordSize; //increment Storage size used by record
     __numRecords ++; //increment num of records within storage
-    __blockSizeUsed += recordSize; //increment Block size used by record
+    __blockSizeUsed += recordBytes; //increment Block size used by record
 
-    return recordAddInfo;
-}
\ No newline at end of file
+    return rid;
+}
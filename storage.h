@@ -1,15 +1,46 @@
 #ifndef STORAGE_H
 #define STORAGE_H
 
+#include <cstdint>
 #include <iostream>
 #include <vector>
 #include <tuple>
 #include <cstring>
+#include <mutex>
+#include <string>
+
+#include "mappedfile.h"
+#include "rid.h"
 
 typedef unsigned char uchar;
 
 using namespace std;
 
+#define STORAGE_HEADER_SIZE 4096 //header page in front of the blocks in a block file
+#define STORAGE_EXTENT_SIZE (16 << 20) //blocks are allocated in extents of up to 16MB, a power of two blocks each
+#define STORAGE_HUGE_PAGE_SIZE (2 << 20)
+#define COMPACT_RATING_SCALE 100 //compact records keep averageRating in hundredths
+
+// back in-memory extents with transparent huge pages where the OS has them
+#ifndef STORAGE_HUGE_PAGES
+#define STORAGE_HUGE_PAGES 1
+#endif
+
+// How records are laid out in a block
+enum BlockFormat {
+    ROW_BLOCKS,     // records packed back to back, append only
+    SLOTTED_BLOCKS, // header, slot directory and records from the block end, deleted slots are reused
+    PAX_BLOCKS,     // one minipage per field, a record is its slot in each minipage, append only
+    COMPRESSED_BLOCKS // records appended whole after a header, every field of a block compressed when
+                      // the storage is rewritten, compressed blocks are read only
+};
+
+// How the fields of a record are stored in a block
+enum RecordEncoding {
+    FULL_RECORDS,   // fields as in Record
+    COMPACT_RECORDS // tconst as its number and averageRating in fixed point, encoded and decoded by Storage
+};
+
 // Record structure
 struct Record {
     char tconst[10]; // 9 chars + \0
@@ -17,32 +48,160 @@ struct Record {
     int numVotes; 
 };
 
+// Record as stored with COMPACT_RECORDS, 10 bytes
+#pragma pack(push, 1)
+struct CompactRecord {
+    uint32_t tconst;        // digits after "tt", num of digits in the high byte to keep leading zeros
+    uint16_t averageRating; // averageRating * COMPACT_RATING_SCALE
+    int numVotes;
+};
+#pragma pack(pop)
+
+inline float decodeCompactRating(uint16_t averageRating) {
+    return averageRating / (float) COMPACT_RATING_SCALE;
+}
+
+// Where the minipages of a PAX block start, field i of slot s is element s of its minipage
+struct PaxLayout {
+    int numRecords;    // records a block holds
+    int ratingsOffset; // float averageRating per record
+    int votesOffset;   // int numVotes per record
+    int tconstOffset;  // tconst per record
+    int ratingSize;    // bytes of averageRating in its minipage, float or fixed point
+    int tconstSize;    // bytes of tconst in its minipage, chars or number
+};
+
+// Bounds of the live records of a block, a block whose bounds miss a predicate can be skipped
+struct ZoneMap {
+    int minVotes;
+    int maxVotes;
+    float minRating;
+    float maxRating;
+    int numRecords; //live records
+};
+
 class Storage {
     private:
         //Storage variables
-        uchar *__storagePtr;
-        int __storageCapacity; //max capacity of the storage
-        int __storageSizeAllocated; //allocated size of storage for blocks
-        int __storageSizeUsed; //used size of storage for records
+        long long __storageCapacity; //max capacity of the storage
+        long long __storageSizeAllocated; //allocated size of storage for blocks
+        long long __storageSizeUsed; //used size of storage for records
         int __numRecords; //num of records
 
+        //Extent variables
+        vector<uchar *> __extents; //start of every extent, reserved up front so readers never see it move
+        vector<MappedFile *> __extentFiles; //mapping of every extent of a block file
+        int __blocksPerExtent;
+        int __extentShift; //block blockNum is in extent blockNum >> __extentShift
+
         //Block variables
         uchar *__blockPtr;
         int __blockCapacity; //max capacity of a block
         int __blockSizeUsed; //used size of a block
         int __blocksAvail; //num of blocks available
         int __blocksUsed; //num of blocks used
+        BlockFormat __format;
+        RecordEncoding __encoding;
+        PaxLayout __pax; //minipages of PAX blocks
+
+        //Free-space map of slotted blocks
+        vector<int> __holeBlocks; //blocks that had a record deleted, popped once their holes are reused
+        vector<bool> __listed; //block is in __holeBlocks
+        vector<bool> __draining; //block being emptied by a vacuum, its holes are not reused meanwhile
+
+        //Zone maps, recomputed for blocks whose records changed once a scan asks for them
+        vector<ZoneMap> __zoneMaps;
+        vector<bool> __zoneStale; //records of the block changed since its zone map was computed
+        vector<int> __staleBlocks; //blocks with __zoneStale set
+
+        //Block file variables
+        string __filename;
+        MappedFile *__file; //mapped header page of the block file, nullptr for in-memory storage
+
+        //guards block allocation and counters
+        mutex __lock;
+
+        //copy counters into the block file header
+        void writeHeader();
+
+        //size extents for the block capacity and reserve room for every extent up to the capacity
+        void initExtents();
+
+        //allocate the next extent in memory or map it from the block file, false if it cannot
+        bool addExtent();
+
+        //free or unmap every extent
+        void releaseExtents();
+
+        //give the pages wholly inside blocks [firstBlock, lastBlock) back to the OS, they read as zeros afterwards
+        void releasePages(int firstBlock, int lastBlock);
+
+        //slot of the next record appended to the current block, caller holds the lock
+        int getNextSlot(int recordBytes);
+
+        //append a record without locking
+        RID appendRecord(int recordSize);
+
+        //put a record in a deleted slot of a slotted block, false if there is none
+        bool reuseHole(RID &rid);
+
+        //put a block with holes in the free-space map unless it is there already or draining
+        void listHoles(int blockNum);
+
+        //rebuild the free-space map from the block headers of a reopened block file
+        void findHoles();
+
+        //bytes taken by a record in a block, with its slot directory entry
+        int getRecordBytes(int recordSize);
+
+        //bytes of a record of recordSize as stored, throws logic_error if compact records are not Records
+        int getStoredSize(int recordSize);
+
+        //bytes in front of the records of a block
+        int getBlockHeaderSize();
+
+        //most records of recordSize a block holds, no more than a RID has slots for
+        int getRecordsPerBlock(int recordSize);
+
+        //write records into fresh compressed blocks in order, with their tconst in compact form in tconsts;
+        //rids gets their RIDs, caller holds the lock
+        void writeCompressedBlocks(const vector<Record> &records, const vector<uint32_t> &tconsts, vector<RID> &rids);
+
+        //read averageRating, numVotes or tconst of slot out of a compressed block
+        float getCompressedRating(const uchar *block, int slot);
+
+        int getCompressedVotes(const uchar *block, int slot);
+
+        uint32_t getCompressedTconst(const uchar *block, int slot);
+
+        //copy the fields of slot out of or into the minipages of a PAX block, as stored
+        void readPaxFields(const uchar *block, int slot, void *averageRating, void *numVotes, void *tconst);
+
+        void writePaxFields(uchar *block, int slot, const void *averageRating, const void *numVotes, const void *tconst);
+
+        //note that records of a block changed, caller holds the lock
+        void markStale(int blockNum);
+
+        //one stale zone map per block used, after the blocks were reopened or rewritten
+        void resetZoneMaps();
 
     public:
-        //constructor
-        Storage(int storageCapacity, int blockCapacity);
+        //constructor, blocks are allocated extent by extent up to storageCapacity bytes
+        //storageCapacity 0 grows the storage up to the blocks a RID addresses
+        Storage(long long storageCapacity, int blockCapacity, BlockFormat format = ROW_BLOCKS, RecordEncoding encoding = FULL_RECORDS);
+
+        //constructor for storage backed by a block file, reopens it if it exists
+        Storage(string filename, long long storageCapacity, int blockCapacity, BlockFormat format = ROW_BLOCKS,
+                RecordEncoding encoding = FULL_RECORDS);
         
         //destructor
         ~Storage();
 
-        int getStorageCapacity();
+        long long getStorageCapacity();
+
+        long long getStorageSizeAllocated();
 
-        int getStorageSizeUsed();
+        long long getStorageSizeUsed();
 
         int getNumRecords();
 
@@ -52,9 +211,113 @@ class Storage {
 
         int getBlocksUsed();
 
+        uchar *getBlockAddress(int blockNum);
+
+        bool isPersistent();
+
+        BlockFormat getBlockFormat();
+
+        RecordEncoding getRecordEncoding();
+
+        //compact form of record, throws logic_error if tconst is not "tt" and up to 7 digits
+        //or averageRating is outside what the fixed point holds
+        static CompactRecord encodeRecord(const Record &record);
+
+        static Record decodeRecord(const CompactRecord &record);
+
+        //write blocks and counters back to the block file
+        void flush();
+
         bool createBlock();
         
-        tuple<uchar*, int> addRecord(int recordSize);
+        //add a record of recordSize bytes, returns its RID
+        //slotted blocks fill the slots of deleted records first
+        //throws logic_error if the record does not fit in a block or the storage is full
+        RID addRecord(int recordSize);
+
+        //delete a record from a slotted block, false if it is not a live record; throws for other formats
+        bool deleteRecord(RID rid);
+
+        //copy a record into a new slot outside draining blocks, returns the RID of the copy
+        RID copyRecord(RID rid);
+
+        //stop or resume reusing the holes of a slotted block while a vacuum empties it, not the last block
+        void setDraining(int blockNum, bool draining);
+
+        //drop the slotted blocks without live records at the end of the storage and give their pages back,
+        //returns how many; emptied blocks before the last live one keep their block num for the free-space map
+        int releaseEmptyBlocks();
+
+        //num of live records in a block
+        int getNumLiveRecords(int blockNum);
+
+        //most records of sizeof(Record) a block holds in this format, for COMPRESSED_BLOCKS before it is compressed
+        int getMaxRecordsPerBlock();
+
+        //most slots of a block, a compressed block holds up to as many records as a RID has slots for
+        int getMaxSlotsPerBlock();
+
+        //reserve consecutive records for one writer, thread-safe like addRecord, returns RID of the first
+        //records are appended after the last block, never put in deleted slots
+        RID reserveRecords(int numRecords, int recordSize);
+
+        //write the records of rids into fresh blocks in that order, records not in rids are dropped;
+        //rids gets the new RIDs, the storage must not be used by other threads meanwhile
+        //COMPRESSED_BLOCKS storage gets compressed blocks, throws logic_error before anything is
+        //rewritten if a tconst is not "tt" and up to 7 digits
+        void rewriteRecords(vector<RID> &rids);
+
+        //RID of the reserved record after rid
+        RID getNextRID(RID rid, int recordSize);
+
+        //address of the record with rid, throws logic_error for PAX blocks and compact records
+        //which keep no Record whole
+        Record *getRecord(RID rid);
+
+        //offset of the record with rid within its block, block may be a copy read through a BufferPool
+        //throws logic_error for PAX blocks
+        int getRecordOffset(const uchar *block, RID rid);
+
+        //copy of the record with rid, gathered from the minipages of PAX blocks and decoded if compact
+        Record readRecord(RID rid);
+
+        //copy of the record with rid out of block, which may be a copy read through a BufferPool
+        Record readRecord(const uchar *block, RID rid);
+
+        //overwrite the record with rid, encoded if compact
+        void writeRecord(RID rid, const Record &record);
+
+        //one field of the record with rid, PAX blocks only touch the minipage of the field
+        float getAverageRating(RID rid);
+
+        int getNumVotes(RID rid);
+
+        //minipages of PAX blocks
+        const PaxLayout &getPaxLayout();
+
+        //true if block of COMPRESSED_BLOCKS storage has been compressed, records of the other blocks are whole
+        bool isCompressed(const uchar *block);
+
+        //numVotes and averageRating of every record of a block of COMPRESSED_BLOCKS storage, returns how many;
+        //block may be a copy read through a BufferPool, votes and ratings need room for getMaxSlotsPerBlock records
+        int decodeColumns(const uchar *block, int *votes, float *ratings);
+
+        //RIDs of all live records in block order
+        void getRIDs(vector<RID> &rids);
+
+        //RIDs of the live records of one block
+        void getRIDs(int blockNum, vector<RID> &rids);
+
+        //slots and offsets in the block of its live records, returns how many; block may be a copy
+        //read through a BufferPool, slots and offsets need room for getMaxSlotsPerBlock records
+        //records of PAX blocks get their slot as offset, their index in every minipage
+        int getLiveRecords(int blockNum, const uchar *block, int *slots, int *offsets);
+
+        //recompute the zone maps of blocks whose records changed, records must be written by now
+        void refreshZoneMaps();
+
+        //zone map of a block as of the last refreshZoneMaps
+        const ZoneMap &getZoneMap(int blockNum);
 
 
 };
@@ -0,0 +1,109 @@
+// Storage with blocks holding more records than a RID has slots for, with full and compact records:
+// records per block are capped at RID_MAX_SLOTS and appends move on to a new block, for addRecord and
+// for reserveRecords with getNextRID.
+// Build from the repository root and run, exits non-zero on a failed check:
+//   g++ -O2 -pthread tests/test_large_blocks.cpp blockscan.cpp bptree.cpp bufferpool.cpp epoch.cpp nodearena.cpp nodesearch.cpp posting.cpp storage.cpp mappedfile.cpp -o test_large_blocks
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "../blockscan.h"
+#include "../bptree.h"
+#include "../storage.h"
+
+using namespace std;
+
+static int numFailed = 0;
+
+static void check(bool ok, const char *what, int blockSize, BlockFormat format, RecordEncoding encoding) {
+    if (!ok) {
+        cout << "FAILED " << what << " (block size " << blockSize << ", format " << format << ", encoding " << encoding << ")" << endl;
+        numFailed++;
+    }
+}
+
+static Record makeRecord(int i) {
+    Record record;
+    snprintf(record.tconst, sizeof(record.tconst), "tt%07u", (unsigned)i % 10000000);
+    record.averageRating = (i % 91 + 10) / 10.0f;
+    record.numVotes = i % 5000;
+    return record;
+}
+
+// add numRecords records one by one and read them back through the index and a scan
+static void testAddRecord(int blockSize, BlockFormat format, RecordEncoding encoding, int numRecords) {
+    Storage storage(0, blockSize, format, encoding);
+    vector<RID> dataEntries;
+    for (int i = 0; i < numRecords; i++) {
+        RID rid = storage.addRecord(sizeof(Record));
+        storage.writeRecord(rid, makeRecord(i));
+        dataEntries.push_back(rid);
+    }
+    check(storage.getMaxRecordsPerBlock() <= (int)RID_MAX_SLOTS, "records per block within RID slots", blockSize, format, encoding);
+    check(storage.getBlocksUsed() == (numRecords + storage.getMaxRecordsPerBlock() - 1) / storage.getMaxRecordsPerBlock(),
+          "blocks used", blockSize, format, encoding);
+
+    long long numLive = 0;
+    for (int blockNum = 0; blockNum < storage.getBlocksUsed(); blockNum++) {
+        numLive += storage.getNumLiveRecords(blockNum);
+    }
+    check(numLive == numRecords, "live records of the blocks", blockSize, format, encoding);
+
+    bool sameRecords = true;
+    for (int i = 0; i < numRecords; i++) {
+        Record record = storage.readRecord(dataEntries[i]);
+        Record expected = makeRecord(i);
+        sameRecords = sameRecords && record.numVotes == expected.numVotes && record.averageRating == expected.averageRating;
+    }
+    check(sameRecords, "records read back", blockSize, format, encoding);
+
+    BPTree bptree(&storage);
+    bptree.bulkLoad(dataEntries, 1.0);
+    Aggregate indexed = bptree.aggregate(0, 99, NUM_VOTES);
+    ScanPredicate predicate;
+    predicate.minVotes = 0;
+    predicate.maxVotes = 99;
+    Aggregate scanned = BlockScan(&storage).aggregate(predicate, NUM_VOTES);
+    check(indexed.count == scanned.count && indexed.count == (long long)numRecords / 5000 * 100, "index and scan counts",
+          blockSize, format, encoding);
+}
+
+// reserve a range of records and step through it with getNextRID like the parallel loader
+static void testReserveRecords(int blockSize, BlockFormat format, RecordEncoding encoding, int numRecords) {
+    Storage storage(0, blockSize, format, encoding);
+    storage.addRecord(sizeof(Record));
+    RID rid = storage.reserveRecords(numRecords, sizeof(Record));
+    vector<RID> rids;
+    for (int i = 0; i < numRecords; i++) {
+        rids.push_back(rid);
+        storage.writeRecord(rid, makeRecord(i));
+        rid = storage.getNextRID(rid, sizeof(Record));
+    }
+    check(getRIDBlock(rids.back()) == storage.getBlocksUsed() - 1, "reserved records end in the last block", blockSize, format, encoding);
+    sort(rids.begin(), rids.end());
+    check(unique(rids.begin(), rids.end()) == rids.end(), "reserved RIDs unique", blockSize, format, encoding);
+    storage.addRecord(sizeof(Record));
+    check(storage.getNumRecords() == numRecords + 2, "records after the reserved range", blockSize, format, encoding);
+}
+
+int main() {
+    int blockSizes[] = {16384, 32768, 65536};
+    BlockFormat formats[] = {ROW_BLOCKS, PAX_BLOCKS, COMPRESSED_BLOCKS};
+    RecordEncoding encodings[] = {FULL_RECORDS, COMPACT_RECORDS};
+    for (RecordEncoding encoding : encodings) {
+        for (int blockSize : blockSizes) {
+            for (BlockFormat format : formats) {
+                testAddRecord(blockSize, format, encoding, 200000);
+                testReserveRecords(blockSize, format, encoding, 5000);
+            }
+        }
+        // slot directory offsets reach no further than 32KB blocks
+        testAddRecord(32760, SLOTTED_BLOCKS, encoding, 200000);
+        testReserveRecords(32760, SLOTTED_BLOCKS, encoding, 5000);
+    }
+
+    cout << (numFailed == 0 ? "all checks passed" : "checks failed") << endl;
+    return numFailed == 0 ? 0 : 1;
+}
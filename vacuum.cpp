@@ -0,0 +1,124 @@
+#include "vacuum.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+#include "bptree.h"
+#include "rid.h"
+#include "storage.h"
+
+using namespace std;
+
+//Vacuum Constructor
+Vacuum::Vacuum(Storage *storage, BPTree *tree, double fillThreshold){
+    __storage = storage;
+    __tree = tree;
+    __fillThreshold = fillThreshold;
+    __nextScan = 0;
+    __nextBlock = 0;
+    __numMoved = 0;
+    __numBlocksEmptied = 0;
+    __numBlocksReleased = 0;
+    __numPasses = 0;
+}
+
+//Vacuum Destructor
+Vacuum::~Vacuum(){
+    flushMoves();
+    finishWindow();
+}
+
+//Collect blocks at or below the fill threshold, the last block still takes appended records
+void Vacuum::fillWindow(chrono::steady_clock::time_point deadline){
+    int maxRecords = __storage->getMaxRecordsPerBlock();
+    while (__nextScan < __storage->getBlocksUsed() - 1 && __blocks.size() < VACUUM_WINDOW_SIZE){
+        int numLive = __storage->getNumLiveRecords(__nextScan);
+        if (numLive > 0 && numLive <= __fillThreshold * maxRecords){
+            //no copy may land in a block of the window, or records would only move between them
+            __storage->setDraining(__nextScan, true);
+            __blocks.push_back(__nextScan);
+        }
+        __nextScan++;
+        if ((__nextScan & 1023) == 0 && chrono::steady_clock::now() >= deadline){
+            break;
+        }
+    }
+}
+
+void Vacuum::finishWindow(){
+    for (size_t i = 0; i < __blocks.size(); i++){
+        __storage->setDraining(__blocks[i], false);
+    }
+    __blocks.clear();
+    __nextBlock = 0;
+}
+
+void Vacuum::flushMoves(){
+    if (!__moves.empty()){
+        __numMoved += __tree->moveRecords(__moves);
+        __moves.clear();
+    }
+}
+
+//Empty blocks of the pass until the budget is used up
+bool Vacuum::runSlice(chrono::microseconds budget){
+    if (__storage->getBlockFormat() != SLOTTED_BLOCKS){
+        throw logic_error("Only slotted blocks can be vacuumed");
+    }
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + budget;
+
+    vector<RID> rids;
+    while (chrono::steady_clock::now() < deadline){
+        if (__nextBlock == __blocks.size()){
+            flushMoves();
+            finishWindow();
+            if (__nextScan >= __storage->getBlocksUsed() - 1){ //pass done
+                __numBlocksReleased += __storage->releaseEmptyBlocks();
+                __nextScan = 0;
+                __numPasses++;
+                return true;
+            }
+            fillWindow(deadline);
+            continue;
+        }
+
+        rids.clear();
+        __storage->getRIDs(__blocks[__nextBlock], rids);
+        for (size_t i = 0; i < rids.size(); i++){
+            RecordMove move;
+            move.key = __storage->getNumVotes(rids[i]);
+            move.from = rids[i];
+            move.to = __storage->copyRecord(rids[i]);
+            __moves.push_back(move);
+        }
+        __nextBlock++;
+        __numBlocksEmptied++;
+        if (__moves.size() >= VACUUM_BATCH_SIZE){
+            flushMoves();
+        }
+    }
+    flushMoves(); //a slice never leaves the index behind storage
+    return false;
+}
+
+void Vacuum::run(){
+    while (!runSlice(chrono::microseconds(1000000))){
+    }
+}
+
+long long Vacuum::getNumMoved(){
+    return __numMoved;
+}
+
+int Vacuum::getNumBlocksEmptied(){
+    return __numBlocksEmptied;
+}
+
+int Vacuum::getNumBlocksReleased(){
+    return __numBlocksReleased;
+}
+
+int Vacuum::getNumPasses(){
+    return __numPasses;
+}
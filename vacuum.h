@@ -0,0 +1,69 @@
+#ifndef VACUUM_H
+#define VACUUM_H
+
+#include <chrono>
+#include <vector>
+
+#include "bptree.h"
+#include "rid.h"
+#include "storage.h"
+
+using namespace std;
+
+#define VACUUM_BATCH_SIZE 256  // moves handed to the index at a time
+#define VACUUM_WINDOW_SIZE 256  // sparse blocks emptied together
+
+// Compacts slotted Storage a time slice at a time. A pass walks the blocks in windows of the ones
+// no fuller than fillThreshold, copies their live records into holes of other blocks or after the
+// last block, and points the index at the copies in batches. Emptied blocks go back to the free-space map,
+// empty blocks at the end of the storage are released once a pass is done.
+class Vacuum {
+    private:
+        Storage *__storage;
+        BPTree *__tree; //index over every record of __storage
+        double __fillThreshold; //blocks with at most this fraction of records live are emptied
+
+        int __nextScan; //next block the pass checks for the window
+        vector<int> __blocks; //window of blocks being emptied
+        size_t __nextBlock; //next of __blocks to empty
+        vector<RecordMove> __moves; //copies the index does not point at yet
+
+        //statistics
+        long long __numMoved;
+        int __numBlocksEmptied;
+        int __numBlocksReleased;
+        int __numPasses;
+
+        //add sparse blocks to an empty window until it is full, the pass is at the last block or deadline
+        void fillWindow(chrono::steady_clock::time_point deadline);
+
+        //give the emptied blocks of the window back to the free-space map
+        void finishWindow();
+
+        //hand the pending moves to the index
+        void flushMoves();
+
+    public:
+        //constructor
+        Vacuum(Storage *storage, BPTree *tree, double fillThreshold = 0.5);
+
+        //destructor, finishes the moves of an interrupted pass
+        ~Vacuum();
+
+        //work on the current pass (starting one if needed) for about budget,
+        //returns true once the pass is done; throws logic_error unless the storage has slotted blocks
+        bool runSlice(chrono::microseconds budget);
+
+        //run a whole pass
+        void run();
+
+        long long getNumMoved();
+
+        int getNumBlocksEmptied();
+
+        int getNumBlocksReleased();
+
+        int getNumPasses();
+};
+
+#endif